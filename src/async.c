@@ -57,7 +57,8 @@ gboolean rsu_async_complete_task(gpointer user_data)
 {
 	rsu_async_cb_data_t *cb_data = user_data;
 
-	cb_data->device->current_task = NULL;
+	if (cb_data->device)
+		cb_data->device->current_task = NULL;
 	cb_data->cb(cb_data->task, cb_data->result, cb_data->error,
 		    cb_data->user_data);
 	prv_rsu_upnp_cb_data_delete(cb_data);
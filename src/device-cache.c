@@ -0,0 +1,332 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "device-cache.h"
+#include "log.h"
+
+#define RSU_DEVICE_CACHE_DIR_NAME "renderer-service-upnp"
+#define RSU_DEVICE_CACHE_FILE_NAME "devices.cache"
+#define RSU_DEVICE_CACHE_VERSION 2
+
+/* Version, then UDN -> (location, time last seen, root properties,
+   player properties).  Times are in seconds since the epoch. */
+#define RSU_DEVICE_CACHE_FORMAT "(ua{s(sxa{sv}a{sv})})"
+#define RSU_DEVICE_CACHE_ENTRY_FORMAT "(sxa{sv}a{sv})"
+
+/* Delay before changes are written back to disk */
+#define RSU_DEVICE_CACHE_SAVE_DELAY 10
+
+/* Renderers not seen for this many seconds are forgotten, and only the
+   most recently seen are kept once there are more than
+   RSU_DEVICE_CACHE_MAX_ENTRIES */
+#define RSU_DEVICE_CACHE_MAX_AGE (30 * 24 * 3600)
+#define RSU_DEVICE_CACHE_MAX_ENTRIES 256
+
+struct rsu_device_cache_t_ {
+	gchar *path;
+	GHashTable *entries;
+	guint save_id;
+	gboolean seen;
+	rsu_device_cache_refresh_t refresh;
+	gpointer user_data;
+};
+
+static gint64 prv_now(void)
+{
+	return g_get_real_time() / G_USEC_PER_SEC;
+}
+
+static gint64 prv_last_seen(GVariant *entry)
+{
+	gint64 last_seen;
+
+	g_variant_get_child(entry, 1, "x", &last_seen);
+
+	return last_seen;
+}
+
+static void prv_expire(rsu_device_cache_t *cache)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	gpointer oldest;
+	gint64 oldest_seen;
+	gint64 limit = prv_now() - RSU_DEVICE_CACHE_MAX_AGE;
+
+	g_hash_table_iter_init(&iter, cache->entries);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		if (prv_last_seen(value) < limit)
+			g_hash_table_iter_remove(&iter);
+
+	while (g_hash_table_size(cache->entries) >
+	       RSU_DEVICE_CACHE_MAX_ENTRIES) {
+		oldest = NULL;
+		oldest_seen = G_MAXINT64;
+
+		g_hash_table_iter_init(&iter, cache->entries);
+		while (g_hash_table_iter_next(&iter, &key, &value)) {
+			if (prv_last_seen(value) < oldest_seen) {
+				oldest = key;
+				oldest_seen = prv_last_seen(value);
+			}
+		}
+
+		g_hash_table_remove(cache->entries, oldest);
+	}
+}
+
+static void prv_load(rsu_device_cache_t *cache)
+{
+	GMappedFile *mapped_file;
+	GVariant *contents = NULL;
+	GVariant *entries = NULL;
+	GVariant *entry;
+	GVariantIter iter;
+	gchar *udn;
+	guint32 version;
+
+	mapped_file = g_mapped_file_new(cache->path, FALSE, NULL);
+	if (!mapped_file)
+		goto on_error;
+
+	/* The entries are not copied out of the file.  They reference the
+	   mapping, which stays alive for as long as any of them do. */
+
+	contents = g_variant_new_from_data(
+		G_VARIANT_TYPE(RSU_DEVICE_CACHE_FORMAT),
+		g_mapped_file_get_contents(mapped_file),
+		g_mapped_file_get_length(mapped_file),
+		FALSE, (GDestroyNotify) g_mapped_file_unref, mapped_file);
+	contents = g_variant_ref_sink(contents);
+
+	g_variant_get_child(contents, 0, "u", &version);
+	if (version != RSU_DEVICE_CACHE_VERSION) {
+		RSU_LOG_INFO("Ignoring device cache version %u", version);
+		goto on_error;
+	}
+
+	entries = g_variant_get_child_value(contents, 1);
+	g_variant_iter_init(&iter, entries);
+
+	while (g_variant_iter_next(&iter, "{s@"RSU_DEVICE_CACHE_ENTRY_FORMAT"}",
+				   &udn, &entry))
+		g_hash_table_insert(cache->entries, udn, entry);
+
+	prv_expire(cache);
+
+	RSU_LOG_DEBUG("Loaded %u devices from %s",
+		      g_hash_table_size(cache->entries), cache->path);
+
+on_error:
+
+	if (entries)
+		g_variant_unref(entries);
+
+	if (contents)
+		g_variant_unref(contents);
+
+	return;
+}
+
+static void prv_save(rsu_device_cache_t *cache)
+{
+	GVariantBuilder vb;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	GVariant *contents;
+	gchar *dir;
+	GError *error = NULL;
+
+	prv_expire(cache);
+	cache->seen = FALSE;
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{s"
+						   RSU_DEVICE_CACHE_ENTRY_FORMAT
+						   "}"));
+	g_hash_table_iter_init(&iter, cache->entries);
+
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_variant_builder_add(&vb, "{s@"RSU_DEVICE_CACHE_ENTRY_FORMAT"}",
+				      key, value);
+
+	contents = g_variant_new("(u@a{s"RSU_DEVICE_CACHE_ENTRY_FORMAT"})",
+				 RSU_DEVICE_CACHE_VERSION,
+				 g_variant_builder_end(&vb));
+	contents = g_variant_ref_sink(contents);
+
+	dir = g_path_get_dirname(cache->path);
+	(void) g_mkdir_with_parents(dir, 0700);
+	g_free(dir);
+
+	/* g_file_set_contents replaces the file atomically so entries still
+	   referencing the old mapping remain valid. */
+
+	if (!g_file_set_contents(cache->path, g_variant_get_data(contents),
+				 g_variant_get_size(contents), &error)) {
+		RSU_LOG_WARNING("Unable to save device cache: %s",
+				error->message);
+		g_error_free(error);
+	}
+
+	g_variant_unref(contents);
+}
+
+static gboolean prv_save_timeout_cb(gpointer user_data)
+{
+	rsu_device_cache_t *cache = user_data;
+
+	/* save_id is only cleared afterwards so that the updates made
+	   by the refresh do not schedule another save */
+
+	cache->refresh(cache->user_data);
+	cache->save_id = 0;
+	prv_save(cache);
+
+	return FALSE;
+}
+
+rsu_device_cache_t *rsu_device_cache_new(rsu_device_cache_refresh_t refresh,
+					 gpointer user_data)
+{
+	rsu_device_cache_t *cache = g_new0(rsu_device_cache_t, 1);
+
+	cache->refresh = refresh;
+	cache->user_data = user_data;
+
+	cache->path = g_build_filename(g_get_user_cache_dir(),
+				       RSU_DEVICE_CACHE_DIR_NAME,
+				       RSU_DEVICE_CACHE_FILE_NAME, NULL);
+	cache->entries = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) g_variant_unref);
+
+	prv_load(cache);
+
+	return cache;
+}
+
+void rsu_device_cache_delete(rsu_device_cache_t *cache)
+{
+	if (cache) {
+		if (cache->save_id)
+			(void) g_source_remove(cache->save_id);
+
+		/* The times at which the renderers present were last seen
+		   are written out even if nothing else has changed */
+
+		if (cache->save_id || cache->seen)
+			prv_save(cache);
+
+		g_hash_table_unref(cache->entries);
+		g_free(cache->path);
+		g_free(cache);
+	}
+}
+
+gboolean rsu_device_cache_lookup(rsu_device_cache_t *cache, const gchar *udn,
+				 const gchar *location, GVariant **root_props,
+				 GVariant **player_props)
+{
+	GVariant *entry;
+	const gchar *cached_location;
+	gboolean retval = FALSE;
+
+	entry = g_hash_table_lookup(cache->entries, udn);
+	if (!entry)
+		goto on_error;
+
+	/* A device that has moved or has been reconfigured publishes its
+	   description at a different location.  Its entry is stale. */
+
+	g_variant_get(entry, "(&sx@a{sv}@a{sv})", &cached_location, NULL,
+		      root_props, player_props);
+
+	if (strcmp(cached_location, location)) {
+		g_variant_unref(*root_props);
+		g_variant_unref(*player_props);
+		goto on_error;
+	}
+
+	retval = TRUE;
+
+on_error:
+
+	return retval;
+}
+
+void rsu_device_cache_update(rsu_device_cache_t *cache, const gchar *udn,
+			     const gchar *location, GVariant *root_props,
+			     GVariant *player_props)
+{
+	GVariant *old_entry;
+	GVariant *entry;
+	GVariant *old_val;
+	GVariant *val;
+	gboolean changed;
+	gsize i;
+
+	entry = g_variant_new("(sx@a{sv}@a{sv})", location, prv_now(),
+			      root_props, player_props);
+	entry = g_variant_ref_sink(entry);
+
+	/* Only a change to what is cached is worth a write.  The time a
+	   renderer was last seen is written out with the next write, or
+	   when the cache is deleted. */
+
+	old_entry = g_hash_table_lookup(cache->entries, udn);
+	changed = !old_entry;
+
+	for (i = 0; i < g_variant_n_children(entry) && !changed; ++i) {
+		if (i == 1)
+			continue;
+
+		old_val = g_variant_get_child_value(old_entry, i);
+		val = g_variant_get_child_value(entry, i);
+		changed = !g_variant_equal(old_val, val);
+		g_variant_unref(val);
+		g_variant_unref(old_val);
+	}
+
+	g_hash_table_insert(cache->entries, g_strdup(udn), entry);
+
+	if (changed)
+		rsu_device_cache_changed(cache);
+	else
+		cache->seen = TRUE;
+}
+
+void rsu_device_cache_changed(rsu_device_cache_t *cache)
+{
+	/* Changes are batched so that several renderers changing at
+	   once cause a single write */
+
+	if (!cache->save_id)
+		cache->save_id = g_timeout_add_seconds(
+			RSU_DEVICE_CACHE_SAVE_DELAY, prv_save_timeout_cb,
+			cache);
+}
@@ -0,0 +1,48 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+#ifndef RSU_DEVICE_CACHE_H__
+#define RSU_DEVICE_CACHE_H__
+
+#include <glib.h>
+
+typedef struct rsu_device_cache_t_ rsu_device_cache_t;
+
+/* Called just before the cache is written so that the entries of the
+   renderers that are still present can be brought up to date */
+
+typedef void (*rsu_device_cache_refresh_t)(gpointer user_data);
+
+rsu_device_cache_t *rsu_device_cache_new(rsu_device_cache_refresh_t refresh,
+					 gpointer user_data);
+void rsu_device_cache_delete(rsu_device_cache_t *cache);
+
+gboolean rsu_device_cache_lookup(rsu_device_cache_t *cache, const gchar *udn,
+				 const gchar *location, GVariant **root_props,
+				 GVariant **player_props);
+void rsu_device_cache_update(rsu_device_cache_t *cache, const gchar *udn,
+			     const gchar *location, GVariant *root_props,
+			     GVariant *player_props);
+void rsu_device_cache_changed(rsu_device_cache_t *cache);
+
+#endif
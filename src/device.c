@@ -28,16 +28,86 @@
 
 #include "async.h"
 #include "device.h"
+#include "duration.h"
 #include "error.h"
+#include "log.h"
 #include "prop-defs.h"
 
+/* Resubscription delays, in seconds, after a subscription is lost.  The
+   delay doubles with each consecutive loss. */
+#define RSU_SUBSCRIPTION_RETRY_MIN 5
+#define RSU_SUBSCRIPTION_RETRY_MAX 600
+
+/* Used when the SCPD of the RenderingControl service cannot be
+   retrieved or does not define a range for Volume */
+#define RSU_VOLUME_DEFAULT_MIN 0
+#define RSU_VOLUME_DEFAULT_MAX 100
+
+/* Large enough for a TransportPlaySpeed of the form "-N/D" */
+#define RSU_SPEED_BUFFER_SIZE 32
+
+/* Largest denominator used when converting a Rate to a
+   TransportPlaySpeed */
+#define RSU_SPEED_MAX_DENOMINATOR 64
+
 typedef void (*rsu_device_local_cb_t)(rsu_async_cb_data_t *cb_data);
 
+typedef struct rsu_device_cached_prop_t_ rsu_device_cached_prop_t;
+struct rsu_device_cached_prop_t_ {
+	const gchar *name;
+	const gchar *type;
+};
+
 typedef struct rsu_device_data_t_ rsu_device_data_t;
 struct rsu_device_data_t_ {
 	rsu_device_local_cb_t local_cb;
 };
 
+/* A task waiting for the initial state of the device to be read */
+
+typedef struct rsu_device_waiter_t_ rsu_device_waiter_t;
+struct rsu_device_waiter_t_ {
+	rsu_async_cb_data_t *cb_data;
+	rsu_device_local_cb_t resume;
+};
+
+/* One of the actions used to read the initial state of the device */
+
+typedef struct rsu_device_query_t_ rsu_device_query_t;
+struct rsu_device_query_t_ {
+	rsu_device_t *device;
+	const gchar *name;
+	GUPnPServiceProxy *proxy;
+	GUPnPServiceProxyAction *action;
+};
+
+/* The Master channel values of instance 0 read from a
+   RenderingControl LastChange */
+
+typedef struct rsu_device_rc_change_t_ rsu_device_rc_change_t;
+struct rsu_device_rc_change_t_ {
+	gboolean in_instance;
+	gint volume;
+	gchar *mute;
+};
+
+/* Properties that are worth remembering across restarts.  Only the
+   capabilities of a renderer are kept.  Its playback state is almost
+   always out of date after a restart.  ProtocolInfo is handled
+   separately as the properties derived from it need to be
+   regenerated. */
+
+static const rsu_device_cached_prop_t g_cached_root_props[] = {
+	{ RSU_INTERFACE_PROP_IDENTITY, "s" },
+	{ NULL, NULL }
+};
+
+static const rsu_device_cached_prop_t g_cached_player_props[] = {
+	{ RSU_INTERFACE_PROP_MINIMUM_RATE, "d" },
+	{ RSU_INTERFACE_PROP_MAXIMUM_RATE, "d" },
+	{ NULL, NULL }
+};
+
 static void prv_last_change_cb(GUPnPServiceProxy *proxy,
 			       const char *variable,
 			       GValue *value,
@@ -48,6 +118,25 @@ static void prv_sink_change_cb(GUPnPServiceProxy *proxy,
 			       GValue *value,
 			       gpointer user_data);
 
+static void prv_rc_last_change_cb(GUPnPServiceProxy *proxy,
+				  const char *variable,
+				  GValue *value,
+				  gpointer user_data);
+
+static void prv_subscription_lost_cb(GUPnPServiceProxy *proxy,
+				     const GError *reason,
+				     gpointer user_data);
+
+static void prv_get_scpds(rsu_device_t *device);
+
+static void prv_send_volume(rsu_device_write_t *write);
+
+static void prv_send_rate(rsu_device_write_t *write);
+
+static void prv_restore_volume(rsu_device_write_t *write);
+
+static void prv_restore_rate(rsu_device_write_t *write);
+
 static void prv_unref_variant(gpointer variant)
 {
 	GVariant *var = variant;
@@ -96,6 +185,24 @@ static void prv_rsu_context_delete(gpointer context)
 			service_proxies->av_proxy, "LastChange",
 			prv_last_change_cb, ctx->device);
 
+		(void) g_signal_handlers_disconnect_by_func(
+			service_proxies->cm_proxy, prv_subscription_lost_cb,
+			ctx->device);
+
+		(void) g_signal_handlers_disconnect_by_func(
+			service_proxies->av_proxy, prv_subscription_lost_cb,
+			ctx->device);
+
+		if (service_proxies->rc_proxy) {
+			(void) gupnp_service_proxy_remove_notify(
+				service_proxies->rc_proxy, "LastChange",
+				prv_rc_last_change_cb, ctx->device);
+
+			(void) g_signal_handlers_disconnect_by_func(
+				service_proxies->rc_proxy,
+				prv_subscription_lost_cb, ctx->device);
+		}
+
 		g_free(ctx->ip_address);
 		if (ctx->device_proxy)
 			g_object_unref(ctx->device_proxy);
@@ -168,21 +275,48 @@ static void prv_context_new(const gchar *ip_address,
 		gupnp_device_info_get_service((GUPnPDeviceInfo *) proxy,
 					      av_type);
 
-	gupnp_service_proxy_set_subscribed(service_proxies->cm_proxy, TRUE);
+	/* As in prv_set_subscribed, the ConnectionManager of an idle
+	   device is subscribed with lazy subscription */
+
+	if (device->subscribed ||
+	    rsu_settings_is_lazy_subscription(device->settings))
+		gupnp_service_proxy_set_subscribed(service_proxies->cm_proxy,
+						   TRUE);
 	(void) gupnp_service_proxy_add_notify(service_proxies->cm_proxy,
 					      "SinkProtocolInfo", G_TYPE_STRING,
 					      prv_sink_change_cb,
 					      device);
 
-	gupnp_service_proxy_set_subscribed(service_proxies->av_proxy, TRUE);
+	if (device->subscribed)
+		gupnp_service_proxy_set_subscribed(service_proxies->av_proxy,
+						   TRUE);
 	(void) gupnp_service_proxy_add_notify(service_proxies->av_proxy,
 					      "LastChange", G_TYPE_STRING,
 					      prv_last_change_cb,
 					      device);
+
+	g_signal_connect(service_proxies->cm_proxy, "subscription-lost",
+			 G_CALLBACK(prv_subscription_lost_cb), device);
+	g_signal_connect(service_proxies->av_proxy, "subscription-lost",
+			 G_CALLBACK(prv_subscription_lost_cb), device);
+
 	service_proxies->rc_proxy = (GUPnPServiceProxy *)
 		gupnp_device_info_get_service((GUPnPDeviceInfo *) proxy,
 					      rc_type);
 
+	if (service_proxies->rc_proxy) {
+		if (device->subscribed)
+			gupnp_service_proxy_set_subscribed(
+				service_proxies->rc_proxy, TRUE);
+		(void) gupnp_service_proxy_add_notify(
+			service_proxies->rc_proxy, "LastChange",
+			G_TYPE_STRING, prv_rc_last_change_cb, device);
+
+		g_signal_connect(service_proxies->rc_proxy,
+				 "subscription-lost",
+				 G_CALLBACK(prv_subscription_lost_cb), device);
+	}
+
 	*context = ctx;
 }
 
@@ -196,6 +330,275 @@ void rsu_device_append_new_context(rsu_device_t *device,
 	g_ptr_array_add(device->contexts, context);
 }
 
+static void prv_set_subscribed(rsu_device_t *device, gboolean subscribed)
+{
+	rsu_device_context_t *context;
+	gboolean cm_subscribed;
+	unsigned int i;
+
+	/* With lazy subscription the ConnectionManager stays subscribed
+	   so that the SinkProtocolInfo of renderers no client has
+	   accessed is known to GetCompatibleServers.  It rarely sends
+	   events. */
+
+	cm_subscribed = subscribed ||
+		rsu_settings_is_lazy_subscription(device->settings);
+
+	if (device->subscribe_id) {
+		(void) g_source_remove(device->subscribe_id);
+		device->subscribe_id = 0;
+	}
+
+	for (i = 0; i < device->contexts->len; ++i) {
+		context = g_ptr_array_index(device->contexts, i);
+
+		gupnp_service_proxy_set_subscribed(
+			context->service_proxies.cm_proxy, cm_subscribed);
+		gupnp_service_proxy_set_subscribed(
+			context->service_proxies.av_proxy, subscribed);
+		if (context->service_proxies.rc_proxy)
+			gupnp_service_proxy_set_subscribed(
+				context->service_proxies.rc_proxy, subscribed);
+	}
+
+	device->subscribed = subscribed;
+	device->subscribe_time = subscribed ? g_get_monotonic_time() : 0;
+}
+
+static gboolean prv_subscribe_cb(gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+
+	device->subscribe_id = 0;
+	prv_set_subscribed(device, TRUE);
+
+	return FALSE;
+}
+
+static gboolean prv_subscribe_cm_cb(gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+
+	device->subscribe_id = 0;
+	prv_set_subscribed(device, FALSE);
+
+	return FALSE;
+}
+
+static void prv_schedule_subscription(rsu_device_t *device, guint delay)
+{
+	guint window;
+
+	/* delay is in seconds.  A random offset within the subscription
+	   window is added to it so that the subscriptions, and thus the
+	   renewals, of different renderers do not line up.  Renderers
+	   tend to lose their subscriptions together, e.g., when the
+	   network goes down, so resubscriptions are always spread over
+	   at least half of their delay. */
+
+	window = rsu_settings_get_subscription_window(device->settings);
+	if (delay > 0)
+		window = MAX(window, delay / 2);
+
+	if (window == 0 && delay == 0) {
+		prv_set_subscribed(device, TRUE);
+		goto on_exit;
+	}
+
+	device->subscribe_id = g_timeout_add(
+		delay * 1000 + g_random_int_range(0, window * 1000 + 1),
+		prv_subscribe_cb, device);
+
+on_exit:
+
+	return;
+}
+
+static void prv_subscription_event(rsu_device_t *device)
+{
+	GVariant *val;
+	gint64 latency;
+
+	/* The first event after a SUBSCRIBE is the initial event message,
+	   so its arrival tells us how long the renderer took to accept
+	   the subscription. */
+
+	if (!device->subscribe_time)
+		goto on_exit;
+
+	latency = g_get_monotonic_time() - device->subscribe_time;
+	device->subscribe_time = 0;
+	device->subscription_retries = 0;
+
+	val = g_variant_ref_sink(g_variant_new_int64(latency));
+	g_hash_table_insert(device->props.root_props,
+			    RSU_INTERFACE_PROP_SUBSCRIPTION_LATENCY, val);
+
+on_exit:
+
+	return;
+}
+
+static void prv_subscription_lost_cb(GUPnPServiceProxy *proxy,
+				     const GError *reason,
+				     gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+	GVariant *val;
+	guint delay;
+	guint i;
+
+	RSU_LOG_WARNING("Lost event subscription to %s: %s", device->path,
+			reason ? reason->message : "unknown reason");
+
+	++device->subscription_failures;
+	val = g_variant_ref_sink(
+		g_variant_new_uint32(device->subscription_failures));
+	g_hash_table_insert(device->props.root_props,
+			    RSU_INTERFACE_PROP_SUBSCRIPTION_FAILURES, val);
+
+	/* All the services of the device are resubscribed together, so
+	   there is nothing more to do if this has already been scheduled.
+	   If lazy subscription has since unsubscribed the device only the
+	   ConnectionManager is resubscribed. */
+
+	if (!device->subscribed) {
+		if (rsu_settings_is_lazy_subscription(device->settings) &&
+		    !device->subscribe_id)
+			device->subscribe_id = g_timeout_add(
+				g_random_int_range(
+					RSU_SUBSCRIPTION_RETRY_MIN * 1000,
+					RSU_SUBSCRIPTION_RETRY_MIN * 1500 + 1),
+				prv_subscribe_cm_cb, device);
+		goto on_exit;
+	}
+
+	prv_set_subscribed(device, FALSE);
+
+	delay = RSU_SUBSCRIPTION_RETRY_MIN;
+	for (i = 0; i < device->subscription_retries &&
+		     delay < RSU_SUBSCRIPTION_RETRY_MAX; ++i)
+		delay *= 2;
+	if (delay > RSU_SUBSCRIPTION_RETRY_MAX)
+		delay = RSU_SUBSCRIPTION_RETRY_MAX;
+
+	++device->subscription_retries;
+	prv_schedule_subscription(device, delay);
+
+on_exit:
+
+	return;
+}
+
+static gboolean prv_subscription_idle_cb(gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+
+	RSU_LOG_DEBUG("No client access to %s, unsubscribing", device->path);
+
+	prv_set_subscribed(device, FALSE);
+	device->idle_id = 0;
+
+	/* Without events the cached state goes stale, so it is read
+	   again on the next access */
+
+	device->props.synced = FALSE;
+
+	return FALSE;
+}
+
+void rsu_device_touch(rsu_device_t *device)
+{
+	if (!rsu_settings_is_lazy_subscription(device->settings))
+		goto on_exit;
+
+	if (!device->subscribed) {
+		RSU_LOG_DEBUG("Client access to %s, subscribing",
+			      device->path);
+
+		prv_set_subscribed(device, TRUE);
+	}
+
+	if (device->idle_id)
+		(void) g_source_remove(device->idle_id);
+
+	device->idle_id = g_timeout_add_seconds(
+		rsu_settings_get_subscription_idle_timeout(device->settings),
+		prv_subscription_idle_cb, device);
+
+on_exit:
+
+	return;
+}
+
+static void prv_write_init(rsu_device_write_t *write, rsu_device_t *device,
+			   const gchar *prop_name,
+			   rsu_device_write_send_t send,
+			   rsu_device_write_restore_t restore)
+{
+	write->device = device;
+	write->prop_name = prop_name;
+	write->send = send;
+	write->restore = restore;
+}
+
+static void prv_write_free(rsu_device_write_t *write)
+{
+	if (write->action)
+		gupnp_service_proxy_cancel_action(write->proxy, write->action);
+
+	if (write->proxy)
+		g_object_unref(write->proxy);
+
+	if (write->pending)
+		g_variant_unref(write->pending);
+
+	if (write->sent)
+		g_variant_unref(write->sent);
+
+	if (write->confirmed)
+		g_variant_unref(write->confirmed);
+}
+
+static void prv_write_confirm(rsu_device_write_t *write, GVariant *value)
+{
+	if (write->confirmed)
+		g_variant_unref(write->confirmed);
+
+	write->confirmed = g_variant_ref_sink(value);
+}
+
+static void prv_sync_query_free(gpointer data)
+{
+	rsu_device_query_t *query = data;
+
+	if (query->action)
+		gupnp_service_proxy_cancel_action(query->proxy, query->action);
+
+	g_object_unref(query->proxy);
+	g_free(query);
+}
+
+static void prv_waiters_lost(rsu_device_t *device)
+{
+	rsu_device_waiter_t *waiter;
+	rsu_async_cb_data_t *cb_data;
+	unsigned int i;
+
+	for (i = 0; i < device->sync_waiters->len; ++i) {
+		waiter = g_ptr_array_index(device->sync_waiters, i);
+		cb_data = waiter->cb_data;
+
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+		cb_data->device = NULL;
+		rsu_async_task_lost_object(cb_data);
+		g_free(waiter);
+	}
+
+	g_ptr_array_unref(device->sync_waiters);
+}
+
 void rsu_device_delete(void *device)
 {
 	unsigned int i;
@@ -206,7 +609,33 @@ void rsu_device_delete(void *device)
 			(void) g_dbus_connection_unregister_object(
 				dev->connection,
 				dev->ids[i]);
+
+		if (dev->idle_id)
+			(void) g_source_remove(dev->idle_id);
+
+		if (dev->subscribe_id)
+			(void) g_source_remove(dev->subscribe_id);
+
+		rsu_scpd_cache_cancel(dev->av_scpd);
+		rsu_scpd_cache_cancel(dev->rc_scpd);
+		g_array_unref(dev->play_speeds);
+
+		prv_write_free(&dev->volume_write);
+		prv_write_free(&dev->rate_write);
+
+		g_ptr_array_unref(dev->sync_queries);
+		g_hash_table_unref(dev->evented);
+		prv_waiters_lost(dev);
+
 		g_ptr_array_unref(dev->contexts);
+
+		if (dev->protocol_info) {
+			rsu_protocol_info_index_update(
+				dev->protocol_info_index, dev->path,
+				dev->protocol_info, NULL);
+			rsu_protocol_info_unref(dev->protocol_info);
+		}
+
 		g_free(dev->path);
 		prv_props_free(&dev->props);
 		g_free(dev);
@@ -218,6 +647,10 @@ gboolean rsu_device_new(GDBusConnection *connection,
 			const gchar *ip_address,
 			guint counter,
 			rsu_interface_info_t *interface_info,
+			rsu_protocol_info_index_t *protocol_info_index,
+			rsu_scpd_cache_t *scpd_cache,
+			rsu_device_cache_t *device_cache,
+			rsu_settings_context_t *settings,
 			void *user_data,
 			rsu_device_t **device)
 {
@@ -227,10 +660,40 @@ gboolean rsu_device_new(GDBusConnection *connection,
 
 	prv_props_init(&dev->props);
 	dev->connection = connection;
+	dev->protocol_info_index = protocol_info_index;
+	dev->scpd_cache = scpd_cache;
+	dev->device_cache = device_cache;
+	dev->settings = settings;
+	dev->volume = -1;
+	dev->volume_min = RSU_VOLUME_DEFAULT_MIN;
+	dev->volume_max = RSU_VOLUME_DEFAULT_MAX;
+	dev->play_speeds = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	prv_write_init(&dev->volume_write, dev, RSU_INTERFACE_PROP_VOLUME,
+		       prv_send_volume, prv_restore_volume);
+	prv_write_init(&dev->rate_write, dev, RSU_INTERFACE_PROP_RATE,
+		       prv_send_rate, prv_restore_rate);
+	dev->sync_queries = g_ptr_array_new_with_free_func(
+		prv_sync_query_free);
+	dev->sync_waiters = g_ptr_array_new();
+	dev->evented = g_hash_table_new(g_str_hash, g_str_equal);
 	dev->contexts = g_ptr_array_new_with_free_func(prv_rsu_context_delete);
 
+	g_hash_table_insert(dev->props.root_props,
+			    RSU_INTERFACE_PROP_SUBSCRIPTION_FAILURES,
+			    g_variant_ref_sink(g_variant_new_uint32(0)));
+	g_hash_table_insert(dev->props.root_props,
+			    RSU_INTERFACE_PROP_SUBSCRIPTION_LATENCY,
+			    g_variant_ref_sink(g_variant_new_int64(0)));
+
 	rsu_device_append_new_context(dev, ip_address, proxy);
 
+	if (!rsu_settings_is_lazy_subscription(settings))
+		prv_schedule_subscription(dev, 0);
+	else
+		prv_set_subscribed(dev, FALSE);
+
+	prv_get_scpds(dev);
+
 	new_path = g_string_new("");
 	g_string_printf(new_path, "%s/%u", RSU_SERVER_PATH, counter);
 
@@ -430,6 +893,28 @@ on_error:
 	return retval;
 }
 
+static void prv_format_transport_speed(gdouble rate, gchar *buffer)
+{
+	gint den;
+	gint num = 0;
+
+	/* buffer must be at least RSU_SPEED_BUFFER_SIZE bytes long */
+
+	for (den = 1; den <= RSU_SPEED_MAX_DENOMINATOR; ++den) {
+		num = (gint) (rate * den + (rate < 0 ? -0.5 : 0.5));
+		if (ABS(rate * den - num) < 0.001)
+			break;
+	}
+
+	if (den > RSU_SPEED_MAX_DENOMINATOR)
+		den = RSU_SPEED_MAX_DENOMINATOR;
+
+	if (den == 1)
+		g_snprintf(buffer, RSU_SPEED_BUFFER_SIZE, "%d", num);
+	else
+		g_snprintf(buffer, RSU_SPEED_BUFFER_SIZE, "%d/%d", num, den);
+}
+
 static void prv_add_actions(rsu_device_t *device, const gchar *actions)
 {
 	gchar **parts;
@@ -519,66 +1004,10 @@ static void prv_add_all_actions(rsu_device_t *device)
 			    g_variant_ref(val));
 }
 
-static gint64 prv_duration_to_int64(const gchar *duration)
-{
-	gchar **parts;
-	unsigned int i = 0;
-	unsigned int count;
-	gint64 pos = 0;
-
-	parts = g_strsplit(duration, ":", 0);
-	for (count = 0; parts[count]; ++count)
-		;
-
-	if (count != 3)
-		goto on_error;
-
-	/* TODO: This does not handle fractional seconds */
-
-	i = 1;
-	do {
-		--count;
-		g_strstrip(parts[count]);
-		pos += atoi(parts[count]) * i;
-		i *= 60;
-	} while (count > 0);
-
-	pos *= 1000000;
-
-on_error:
-
-	g_strfreev(parts);
-
-	return pos;
-}
-
-static gchar *prv_int64_to_duration(gint64 micro_seconds)
-{
-	GString *retval;
-	unsigned int seconds;
-
-	if (micro_seconds < 0) {
-		retval = g_string_new("-");
-		micro_seconds = -micro_seconds;
-	} else {
-		retval = g_string_new("");
-	}
-
-	/* TODO: This does not handle fractional seconds */
-
-	seconds = micro_seconds / 1000000;
-	g_string_append_printf(retval, "%02u:%02u:%02u",
-			       seconds / 3600,
-			       (seconds / 60) % 60,
-			       seconds % 60);
-
-	return g_string_free(retval, FALSE);
-}
-
 static void prv_add_reltime(rsu_device_t *device, const gchar *reltime)
 {
 	GVariant *val;
-	gint64 pos = prv_duration_to_int64(reltime);
+	gint64 pos = rsu_duration_to_int64(reltime);
 
 	val = g_variant_ref_sink(g_variant_new_int64(pos));
 	g_hash_table_insert(device->props.player_props,
@@ -684,7 +1113,7 @@ static void prv_add_track_meta_data(rsu_device_t *device, const gchar *metadata,
 	vb = g_variant_builder_new(G_VARIANT_TYPE("a{sv}"));
 
 	if (duration) {
-		val = g_variant_new_int64(prv_duration_to_int64(duration));
+		val = g_variant_new_int64(rsu_duration_to_int64(duration));
 		g_variant_builder_add(vb, "{sv}", "mpris:length", val);
 	}
 
@@ -716,6 +1145,72 @@ on_error:
 	g_free(didl);
 }
 
+static void prv_update_track(rsu_device_t *device, const gchar *meta_data,
+			     const gchar *duration, const gchar *uri)
+{
+	GVariant *val;
+
+	if (meta_data) {
+		prv_add_track_meta_data(device, meta_data, duration, uri);
+	} else {
+		if (duration) {
+			val = g_variant_new_int64(rsu_duration_to_int64(
+							  duration));
+			val = g_variant_ref_sink(val);
+			prv_merge_meta_data(device, "mpris:length", val);
+			g_variant_unref(val);
+		}
+
+		if (uri) {
+			val = g_variant_ref_sink(g_variant_new_string(uri));
+			prv_merge_meta_data(device, "xesam:url", val);
+			g_variant_unref(val);
+		}
+	}
+}
+
+static void prv_add_rate(rsu_device_t *device, const gchar *play_speed)
+{
+	GVariant *val;
+
+	val = g_variant_ref_sink(
+		g_variant_new_double(prv_map_transport_speed(play_speed)));
+	prv_write_confirm(&device->rate_write, val);
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_RATE, val);
+}
+
+static void prv_add_playback_status(rsu_device_t *device, const gchar *state)
+{
+	GVariant *val;
+
+	val = g_variant_ref_sink(
+		g_variant_new_string(prv_map_transport_state(state)));
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_PLAYBACK_STATUS, val);
+}
+
+static void prv_add_mute(rsu_device_t *device, gboolean mute)
+{
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_MUTE,
+			    g_variant_ref_sink(g_variant_new_boolean(mute)));
+}
+
+static void prv_mark_evented(rsu_device_t *device, const gchar *variable,
+			     gboolean present)
+{
+	/* variable must be a static string */
+
+	if (present && device->sync_queries->len)
+		g_hash_table_add(device->evented, (gchar *) variable);
+}
+
+static gboolean prv_is_evented(rsu_device_t *device, const gchar *variable)
+{
+	return g_hash_table_contains(device->evented, variable);
+}
+
 static void prv_last_change_cb(GUPnPServiceProxy *proxy,
 			       const char *variable,
 			       GValue *value,
@@ -729,7 +1224,8 @@ static void prv_last_change_cb(GUPnPServiceProxy *proxy,
 	gchar *state = NULL;
 	gchar *duration = NULL;
 	gchar *uri = NULL;
-	GVariant *val;
+
+	prv_subscription_event(device);
 
 	parser = gupnp_last_change_parser_new();
 
@@ -746,25 +1242,16 @@ static void prv_last_change_cb(GUPnPServiceProxy *proxy,
 		    NULL))
 		goto on_error;
 
-	if (meta_data) {
-		prv_add_track_meta_data(device, meta_data, duration, uri);
-		g_free(meta_data);
-	} else {
-		if (duration) {
-			val = g_variant_new_int64(prv_duration_to_int64(
-							  duration));
-			val = g_variant_ref_sink(val);
-			prv_merge_meta_data(device, "mpris:length", val);
-			g_variant_unref(val);
-		}
+	prv_mark_evented(device, "CurrentTrackMetaData", meta_data != NULL);
+	prv_mark_evented(device, "CurrentTransportActions", actions != NULL);
+	prv_mark_evented(device, "TransportPlaySpeed", play_speed != NULL);
+	prv_mark_evented(device, "TransportState", state != NULL);
+	prv_mark_evented(device, "CurrentTrackDuration", duration != NULL);
+	prv_mark_evented(device, "CurrentTrackURI", uri != NULL);
 
-		if (uri) {
-			val = g_variant_ref_sink(g_variant_new_string(uri));
-			prv_merge_meta_data(device, "xesam:url", val);
-			g_variant_unref(val);
-		}
-	}
+	prv_update_track(device, meta_data, duration, uri);
 
+	g_free(meta_data);
 	g_free(duration);
 	g_free(uri);
 
@@ -774,21 +1261,12 @@ static void prv_last_change_cb(GUPnPServiceProxy *proxy,
 	}
 
 	if (play_speed) {
-		val = g_variant_ref_sink(
-			g_variant_new_double(
-				prv_map_transport_speed(play_speed)));
-		g_hash_table_insert(device->props.player_props,
-				    RSU_INTERFACE_PROP_RATE, val);
+		prv_add_rate(device, play_speed);
 		g_free(play_speed);
 	}
 
 	if (state) {
-		val = g_variant_ref_sink(
-			g_variant_new_string(
-				prv_map_transport_state(state)));
-		g_hash_table_insert(device->props.player_props,
-				    RSU_INTERFACE_PROP_PLAYBACK_STATUS,
-				    val);
+		prv_add_playback_status(device, state);
 		g_free(state);
 	}
 
@@ -797,79 +1275,374 @@ on_error:
 	g_object_unref(parser);
 }
 
-
-static void prv_as_prop_from_hash_table(const gchar *prop_name,
-					GHashTable *values, GHashTable *props)
+static void prv_update_volume(rsu_device_t *device)
 {
-	GVariantBuilder vb;
-	GHashTableIter iter;
-	gpointer key;
 	GVariant *val;
+	gdouble volume;
+
+	if (device->volume < 0)
+		goto on_exit;
+
+	if (device->volume <= device->volume_min)
+		volume = 0.0;
+	else if (device->volume >= device->volume_max)
+		volume = 1.0;
+	else
+		volume = (gdouble) (device->volume - device->volume_min) /
+			(device->volume_max - device->volume_min);
+
+	val = g_variant_ref_sink(g_variant_new_double(volume));
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_VOLUME, val);
+
+on_exit:
+
+	return;
+}
+
+static const gchar *prv_local_name(const gchar *name)
+{
+	const gchar *local = strrchr(name, ':');
+
+	return local ? local + 1 : name;
+}
+
+static void prv_rc_start_element(GMarkupParseContext *context,
+				 const gchar *element_name,
+				 const gchar **attribute_names,
+				 const gchar **attribute_values,
+				 gpointer user_data,
+				 GError **error)
+{
+	rsu_device_rc_change_t *change = user_data;
+	const gchar *name = prv_local_name(element_name);
+	const gchar *channel = NULL;
+	const gchar *val = NULL;
+	gchar *end;
+	gint64 volume;
+	unsigned int i;
+
+	for (i = 0; attribute_names[i]; ++i) {
+		if (!strcmp(attribute_names[i], "channel"))
+			channel = attribute_values[i];
+		else if (!strcmp(attribute_names[i], "val"))
+			val = attribute_values[i];
+	}
+
+	if (!strcmp(name, "InstanceID")) {
+		change->in_instance = val && !strcmp(val, "0");
+		goto on_exit;
+	}
+
+	/* Renderers event each of their channels, in any order.  Only
+	   the Master channel is read, as by GetVolume and SetVolume. */
+
+	if (!change->in_instance || !val ||
+	    (channel && strcmp(channel, "Master")))
+		goto on_exit;
 
-	g_variant_builder_init(&vb, G_VARIANT_TYPE("as"));
-	g_hash_table_iter_init(&iter, values);
+	if (!strcmp(name, "Volume")) {
+		volume = g_ascii_strtoll(val, &end, 10);
+		if (end != val && volume >= 0 && volume <= G_MAXINT)
+			change->volume = (gint) volume;
+	} else if (!strcmp(name, "Mute")) {
+		g_free(change->mute);
+		change->mute = g_strdup(val);
+	}
+
+on_exit:
+
+	return;
+}
+
+static void prv_rc_end_element(GMarkupParseContext *context,
+			       const gchar *element_name,
+			       gpointer user_data,
+			       GError **error)
+{
+	rsu_device_rc_change_t *change = user_data;
+
+	if (!strcmp(prv_local_name(element_name), "InstanceID"))
+		change->in_instance = FALSE;
+}
+
+static void prv_rc_last_change_cb(GUPnPServiceProxy *proxy,
+				  const char *variable,
+				  GValue *value,
+				  gpointer user_data)
+{
+	static const GMarkupParser parser = {
+		prv_rc_start_element, prv_rc_end_element, NULL, NULL, NULL
+	};
+	GMarkupParseContext *context;
+	rsu_device_t *device = user_data;
+	rsu_device_rc_change_t change = { FALSE, -1, NULL };
+	const gchar *last_change = g_value_get_string(value);
+
+	prv_subscription_event(device);
+
+	if (!last_change)
+		goto on_exit;
+
+	context = g_markup_parse_context_new(&parser, 0, &change, NULL);
 
-	while (g_hash_table_iter_next(&iter, &key, NULL))
-		g_variant_builder_add(&vb, "s", key);
+	if (!g_markup_parse_context_parse(context, last_change, -1, NULL) ||
+	    !g_markup_parse_context_end_parse(context, NULL)) {
+		g_markup_parse_context_free(context);
+		goto on_exit;
+	}
+
+	g_markup_parse_context_free(context);
+
+	prv_mark_evented(device, "Volume", change.volume >= 0);
+	prv_mark_evented(device, "Mute", change.mute != NULL);
+
+	if (change.volume >= 0) {
+		device->volume = change.volume;
+		prv_write_confirm(&device->volume_write,
+				  g_variant_new_int32(change.volume));
+		prv_update_volume(device);
+	}
+
+	if (change.mute) {
+		g_strstrip(change.mute);
+		prv_add_mute(device, !strcmp(change.mute, "1") ||
+			     !g_ascii_strcasecmp(change.mute, "true"));
+	}
 
-	val = g_variant_ref_sink(g_variant_builder_end(&vb));
-	g_hash_table_insert(props, (gchar *) prop_name, val);
+on_exit:
+
+	g_free(change.mute);
+}
+
+static gboolean prv_value_to_int(const GValue *value, gint *result)
+{
+	GValue int_val = { 0, };
+	gboolean retval;
+
+	/* Volume is usually a ui2, but some renderers declare it as i2 or
+	   i4 */
+
+	g_value_init(&int_val, G_TYPE_INT);
+	retval = g_value_transform(value, &int_val);
+	if (retval)
+		*result = g_value_get_int(&int_val);
+	g_value_unset(&int_val);
+
+	return retval;
+}
+
+static void prv_rc_scpd_cb(GUPnPServiceIntrospection *introspection,
+			   const GError *error, gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+	const GUPnPServiceStateVariableInfo *variable;
+	gint min;
+	gint max;
+
+	device->rc_scpd = NULL;
+
+	if (error)
+		goto on_exit;
+
+	variable = gupnp_service_introspection_get_state_variable(
+		introspection, "Volume");
+
+	if (variable && variable->is_numeric &&
+	    prv_value_to_int(&variable->minimum, &min) &&
+	    prv_value_to_int(&variable->maximum, &max) && min < max) {
+		device->volume_min = min;
+		device->volume_max = max;
+		prv_update_volume(device);
+	}
+
+on_exit:
+
+	return;
+}
+
+static gint prv_compare_speeds(gconstpointer a, gconstpointer b)
+{
+	gdouble speed_a = *(const gdouble *) a;
+	gdouble speed_b = *(const gdouble *) b;
+
+	return speed_a < speed_b ? -1 : speed_a > speed_b ? 1 : 0;
+}
+
+static void prv_av_scpd_cb(GUPnPServiceIntrospection *introspection,
+			   const GError *error, gpointer user_data)
+{
+	rsu_device_t *device = user_data;
+	const GUPnPServiceStateVariableInfo *variable;
+	GArray *speeds = device->play_speeds;
+	GList *ptr;
+	gdouble speed;
+
+	device->av_scpd = NULL;
+
+	if (error)
+		goto on_exit;
+
+	variable = gupnp_service_introspection_get_state_variable(
+		introspection, "TransportPlaySpeed");
+	if (!variable)
+		goto on_exit;
+
+	g_array_set_size(speeds, 0);
+
+	for (ptr = variable->allowed_values; ptr; ptr = ptr->next) {
+		speed = prv_map_transport_speed(ptr->data);
+		if (speed != 0.0)
+			g_array_append_val(speeds, speed);
+	}
+
+	if (speeds->len == 0)
+		goto on_exit;
+
+	g_array_sort(speeds, prv_compare_speeds);
+
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_MINIMUM_RATE,
+			    g_variant_ref_sink(g_variant_new_double(
+				g_array_index(speeds, gdouble, 0))));
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_MAXIMUM_RATE,
+			    g_variant_ref_sink(g_variant_new_double(
+				g_array_index(speeds, gdouble,
+					      speeds->len - 1))));
+	rsu_device_cache_changed(device->device_cache);
+
+on_exit:
+
+	return;
+}
+
+static void prv_get_scpds(rsu_device_t *device)
+{
+	rsu_device_context_t *context;
+	GUPnPDeviceInfo *info;
+
+	context = rsu_device_get_context(device);
+	info = (GUPnPDeviceInfo *) context->device_proxy;
+
+	if (context->service_proxies.av_proxy)
+		device->av_scpd = rsu_scpd_cache_lookup(
+			device->scpd_cache, info,
+			(GUPnPServiceInfo *) context->service_proxies.av_proxy,
+			prv_av_scpd_cb, device);
+
+	if (context->service_proxies.rc_proxy)
+		device->rc_scpd = rsu_scpd_cache_lookup(
+			device->scpd_cache, info,
+			(GUPnPServiceInfo *) context->service_proxies.rc_proxy,
+			prv_rc_scpd_cb, device);
 }
 
 static void prv_process_protocol_info(rsu_device_t *device,
 				      const gchar *protocol_info)
 {
-	GVariant *val;
-	gchar **entries;
-	gchar **type_info;
-	unsigned int i;
-	GHashTable *protocols;
-	GHashTable *types;
-	const char http_prefix[] = "http-";
+	rsu_protocol_info_t *info = device->protocol_info;
+
+	/* Renderers resend the same SinkProtocolInfo on every
+	   resubscription.  There is nothing to do if it has not changed. */
 
-	protocols = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
-					  NULL);
-	types = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	if (info && !strcmp(info->protocol_info, protocol_info))
+		goto on_exit;
+
+	device->protocol_info = rsu_protocol_info_get(protocol_info);
+	rsu_protocol_info_index_update(device->protocol_info_index,
+				       device->path, info,
+				       device->protocol_info);
+	rsu_device_cache_changed(device->device_cache);
 
-	val = g_variant_ref_sink(g_variant_new_string(protocol_info));
 	g_hash_table_insert(device->props.root_props,
 			    RSU_INTERFACE_PROP_PROTOCOL_INFO,
-			    val);
+			    g_variant_ref(device->protocol_info->
+					  protocol_info_val));
 
-	entries = g_strsplit(protocol_info, ",", 0);
+	g_hash_table_insert(device->props.root_props,
+			    RSU_INTERFACE_PROP_SUPPORTED_URIS,
+			    g_variant_ref(device->protocol_info->uri_schemes));
 
-	for (i = 0; entries[i]; ++i) {
-		type_info = g_strsplit(entries[i], ":", 0);
+	g_hash_table_insert(device->props.root_props,
+			    RSU_INTERFACE_PROP_SUPPORTED_MIME,
+			    g_variant_ref(device->protocol_info->mime_types));
 
-		if (type_info[0] && type_info[1] && type_info[2]) {
-			if (!g_ascii_strncasecmp(http_prefix, type_info[0],
-						 sizeof(http_prefix) - 1)) {
-				type_info[0][sizeof(http_prefix) - 2] = 0;
-			}
+	rsu_protocol_info_unref(info);
 
-			g_hash_table_insert(protocols,
-					    g_ascii_strdown(type_info[0], -1),
-					    NULL);
-			g_hash_table_insert(types,
-					    g_ascii_strdown(type_info[2], -1),
-					    NULL);
-		}
+on_exit:
+
+	return;
+}
+
+static void prv_add_cached_props(GVariantBuilder *vb, GHashTable *props,
+				 const rsu_device_cached_prop_t *cached_props)
+{
+	GVariant *val;
+
+	for (; cached_props->name; ++cached_props) {
+		val = g_hash_table_lookup(props, cached_props->name);
+		if (val)
+			g_variant_builder_add(vb, "{sv}", cached_props->name,
+					      val);
+	}
+}
+
+static void prv_cached_props_from_variant(
+	GHashTable *props, const rsu_device_cached_prop_t *cached_props,
+	GVariant *cached)
+{
+	GVariant *val;
 
-		g_strfreev(type_info);
+	for (; cached_props->name; ++cached_props) {
+		val = g_variant_lookup_value(
+			cached, cached_props->name,
+			G_VARIANT_TYPE(cached_props->type));
+		if (val)
+			g_hash_table_insert(props, (gchar *) cached_props->name,
+					    val);
 	}
+}
+
+void rsu_device_save_props(rsu_device_t *device, GVariant **root_props,
+			   GVariant **player_props)
+{
+	GVariantBuilder vb;
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+	prv_add_cached_props(&vb, device->props.root_props,
+			     g_cached_root_props);
+
+	if (device->protocol_info)
+		g_variant_builder_add(&vb, "{sv}",
+				      RSU_INTERFACE_PROP_PROTOCOL_INFO,
+				      device->protocol_info->
+				      protocol_info_val);
 
-	g_strfreev(entries);
+	*root_props = g_variant_builder_end(&vb);
 
-	prv_as_prop_from_hash_table(RSU_INTERFACE_PROP_SUPPORTED_URIS,
-				    protocols,
-				    device->props.root_props);
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("a{sv}"));
+	prv_add_cached_props(&vb, device->props.player_props,
+			     g_cached_player_props);
+	*player_props = g_variant_builder_end(&vb);
+}
+
+void rsu_device_restore_props(rsu_device_t *device, GVariant *root_props,
+			      GVariant *player_props)
+{
+	const gchar *protocol_info;
+
+	/* The cached values are provisional.  They are overwritten as soon
+	   as the renderer sends its own values. */
 
-	prv_as_prop_from_hash_table(RSU_INTERFACE_PROP_SUPPORTED_MIME,
-				    types,
-				    device->props.root_props);
+	prv_cached_props_from_variant(device->props.root_props,
+				      g_cached_root_props, root_props);
+	prv_cached_props_from_variant(device->props.player_props,
+				      g_cached_player_props, player_props);
 
-	g_hash_table_unref(types);
-	g_hash_table_unref(protocols);
+	if (g_variant_lookup(root_props, RSU_INTERFACE_PROP_PROTOCOL_INFO,
+			     "&s", &protocol_info))
+		prv_process_protocol_info(device, protocol_info);
 }
 
 static void prv_sink_change_cb(GUPnPServiceProxy *proxy,
@@ -880,7 +1653,10 @@ static void prv_sink_change_cb(GUPnPServiceProxy *proxy,
 	rsu_device_t *device = user_data;
 	const gchar *sink;
 
+	prv_subscription_event(device);
+
 	sink = g_value_get_string(value);
+	prv_mark_evented(device, "SinkProtocolInfo", sink != NULL);
 
 	if (sink)
 		prv_process_protocol_info(device, sink);
@@ -939,7 +1715,7 @@ static void prv_get_position_info(GCancellable *cancellable,
 						 NULL);
 }
 
-static void prv_props_update(rsu_device_t *device, rsu_task_t *task)
+static void prv_props_update(rsu_device_t *device)
 {
 	GVariant *val;
 	GUPnPDeviceInfo *info;
@@ -964,20 +1740,40 @@ static void prv_props_update(rsu_device_t *device, rsu_task_t *task)
 			    RSU_INTERFACE_PROP_HAS_TRACK_LIST,
 			    g_variant_ref(val));
 
-	/* TODO:  The following three properties require information to
-	   be read out of the service file to be properly implemented.
-	   The problem is that GUPnP does not currently allow you to
-	   cancel requests to access the service file */
+	/* MinimumRate and MaximumRate are replaced by the allowed values
+	   of TransportPlaySpeed once the AVTransport SCPD is parsed */
 
 	val = g_variant_ref_sink(g_variant_new_double(1.0));
-	g_hash_table_insert(props->player_props,
-			    RSU_INTERFACE_PROP_MINIMUM_RATE, val);
-	g_hash_table_insert(props->player_props,
-			    RSU_INTERFACE_PROP_MAXIMUM_RATE,
-			    g_variant_ref(val));
-	g_hash_table_insert(props->player_props,
-			    RSU_INTERFACE_PROP_VOLUME,
-			    g_variant_ref(val));
+
+	if (!g_hash_table_lookup(props->player_props,
+				 RSU_INTERFACE_PROP_MINIMUM_RATE))
+		g_hash_table_insert(props->player_props,
+				    RSU_INTERFACE_PROP_MINIMUM_RATE,
+				    g_variant_ref(val));
+
+	if (!g_hash_table_lookup(props->player_props,
+				 RSU_INTERFACE_PROP_MAXIMUM_RATE))
+		g_hash_table_insert(props->player_props,
+				    RSU_INTERFACE_PROP_MAXIMUM_RATE,
+				    g_variant_ref(val));
+
+	/* Volume and Mute are evented by RenderingControl.  These
+	   defaults are only used until the first event arrives. */
+
+	if (!g_hash_table_lookup(props->player_props,
+				 RSU_INTERFACE_PROP_VOLUME))
+		g_hash_table_insert(props->player_props,
+				    RSU_INTERFACE_PROP_VOLUME,
+				    g_variant_ref(val));
+
+	g_variant_unref(val);
+
+	if (!g_hash_table_lookup(props->player_props,
+				 RSU_INTERFACE_PROP_MUTE))
+		g_hash_table_insert(props->player_props,
+				    RSU_INTERFACE_PROP_MUTE,
+				    g_variant_ref_sink(
+					    g_variant_new_boolean(FALSE)));
 
 	info = (GUPnPDeviceInfo *) context->device_proxy;
 	friendly_name = gupnp_device_info_get_friendly_name(info);
@@ -985,8 +1781,323 @@ static void prv_props_update(rsu_device_t *device, rsu_task_t *task)
 	g_free(friendly_name);
 	g_hash_table_insert(props->root_props, RSU_INTERFACE_PROP_IDENTITY,
 			    val);
-	prv_add_all_actions(device);
+
+	if (!g_hash_table_lookup(props->player_props,
+				 RSU_INTERFACE_PROP_CAN_PLAY))
+		prv_add_all_actions(device);
+}
+
+static void prv_sync_complete(rsu_device_t *device)
+{
+	rsu_device_waiter_t *waiter;
+	rsu_async_cb_data_t *cb_data;
+	unsigned int i;
+
+	RSU_LOG_DEBUG("Initial state of %s retrieved", device->path);
+
 	device->props.synced = TRUE;
+
+	for (i = 0; i < device->sync_waiters->len; ++i) {
+		waiter = g_ptr_array_index(device->sync_waiters, i);
+		cb_data = waiter->cb_data;
+
+		g_cancellable_disconnect(cb_data->cancellable,
+					 cb_data->cancel_id);
+		cb_data->cancel_id = 0;
+		waiter->resume(cb_data);
+		g_free(waiter);
+	}
+
+	g_ptr_array_set_size(device->sync_waiters, 0);
+}
+
+static rsu_device_query_t *prv_sync_query_new(rsu_device_t *device,
+					      GUPnPServiceProxy *proxy,
+					      const gchar *name)
+{
+	rsu_device_query_t *query = g_new0(rsu_device_query_t, 1);
+
+	query->device = device;
+	query->name = name;
+	query->proxy = g_object_ref(proxy);
+	g_ptr_array_add(device->sync_queries, query);
+
+	return query;
+}
+
+static void prv_sync_query_done(rsu_device_query_t *query,
+				GError *upnp_error)
+{
+	rsu_device_t *device = query->device;
+
+	/* Some of these actions are optional.  The defaults, or values
+	   received in events, are kept if they fail. */
+
+	if (upnp_error) {
+		RSU_LOG_DEBUG("%s failed on %s: %s", query->name,
+			      device->path, upnp_error->message);
+		g_error_free(upnp_error);
+	}
+
+	query->action = NULL;
+	(void) g_ptr_array_remove_fast(device->sync_queries, query);
+
+	if (device->sync_queries->len == 0)
+		prv_sync_complete(device);
+}
+
+static void prv_sync_transport_info_cb(GUPnPServiceProxy *proxy,
+				       GUPnPServiceProxyAction *action,
+				       gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gchar *state = NULL;
+	gchar *speed = NULL;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "CurrentTransportState",
+					   G_TYPE_STRING, &state,
+					   "CurrentSpeed",
+					   G_TYPE_STRING, &speed,
+					   NULL)) {
+		if (state && !prv_is_evented(query->device, "TransportState"))
+			prv_add_playback_status(query->device, state);
+		if (speed &&
+		    !prv_is_evented(query->device, "TransportPlaySpeed"))
+			prv_add_rate(query->device, speed);
+		g_free(state);
+		g_free(speed);
+	}
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+static void prv_sync_position_info_cb(GUPnPServiceProxy *proxy,
+				      GUPnPServiceProxyAction *action,
+				      gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gchar *meta_data = NULL;
+	gchar *duration = NULL;
+	gchar *uri = NULL;
+	gchar *rel_pos = NULL;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "TrackMetaData",
+					   G_TYPE_STRING, &meta_data,
+					   "TrackDuration",
+					   G_TYPE_STRING, &duration,
+					   "TrackURI",
+					   G_TYPE_STRING, &uri,
+					   "RelTime",
+					   G_TYPE_STRING, &rel_pos,
+					   NULL)) {
+		prv_update_track(
+			query->device,
+			prv_is_evented(query->device, "CurrentTrackMetaData") ?
+			NULL : meta_data,
+			prv_is_evented(query->device, "CurrentTrackDuration") ?
+			NULL : duration,
+			prv_is_evented(query->device, "CurrentTrackURI") ?
+			NULL : uri);
+		if (rel_pos) {
+			g_strstrip(rel_pos);
+			prv_add_reltime(query->device, rel_pos);
+		}
+		g_free(meta_data);
+		g_free(duration);
+		g_free(uri);
+		g_free(rel_pos);
+	}
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+static void prv_sync_transport_actions_cb(GUPnPServiceProxy *proxy,
+					  GUPnPServiceProxyAction *action,
+					  gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gchar *actions = NULL;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "Actions", G_TYPE_STRING, &actions,
+					   NULL) && actions) {
+		if (!prv_is_evented(query->device, "CurrentTransportActions"))
+			prv_add_actions(query->device, actions);
+		g_free(actions);
+	}
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+static void prv_sync_volume_cb(GUPnPServiceProxy *proxy,
+			       GUPnPServiceProxyAction *action,
+			       gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gint volume = -1;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "CurrentVolume", G_TYPE_INT, &volume,
+					   NULL) && volume >= 0 &&
+	    !prv_is_evented(query->device, "Volume")) {
+		query->device->volume = volume;
+		prv_write_confirm(&query->device->volume_write,
+				  g_variant_new_int32(volume));
+		prv_update_volume(query->device);
+	}
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+static void prv_sync_mute_cb(GUPnPServiceProxy *proxy,
+			     GUPnPServiceProxyAction *action,
+			     gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gboolean mute;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "CurrentMute", G_TYPE_BOOLEAN, &mute,
+					   NULL) &&
+	    !prv_is_evented(query->device, "Mute"))
+		prv_add_mute(query->device, mute);
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+static void prv_sync_protocol_info_cb(GUPnPServiceProxy *proxy,
+				      GUPnPServiceProxyAction *action,
+				      gpointer user_data)
+{
+	rsu_device_query_t *query = user_data;
+	GError *upnp_error = NULL;
+	gchar *sink = NULL;
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   "Sink", G_TYPE_STRING, &sink,
+					   NULL) && sink) {
+		if (!prv_is_evented(query->device, "SinkProtocolInfo"))
+			prv_process_protocol_info(query->device, sink);
+		g_free(sink);
+	}
+
+	prv_sync_query_done(query, upnp_error);
+}
+
+void rsu_device_sync(rsu_device_t *device)
+{
+	rsu_device_context_t *context;
+	rsu_service_proxies_t *proxies;
+	rsu_device_query_t *query;
+
+	/* Reads the initial state of the device.  All the actions are
+	   issued at once and the device is only marked as synced once
+	   the last of them has completed. */
+
+	if (device->props.synced || device->sync_queries->len)
+		goto on_exit;
+
+	g_hash_table_remove_all(device->evented);
+	prv_props_update(device);
+
+	context = rsu_device_get_context(device);
+	proxies = &context->service_proxies;
+
+	query = prv_sync_query_new(device, proxies->av_proxy,
+				   "GetTransportInfo");
+	query->action = gupnp_service_proxy_begin_action(
+		query->proxy, query->name, prv_sync_transport_info_cb, query,
+		"InstanceID", G_TYPE_INT, 0, NULL);
+
+	query = prv_sync_query_new(device, proxies->av_proxy,
+				   "GetPositionInfo");
+	query->action = gupnp_service_proxy_begin_action(
+		query->proxy, query->name, prv_sync_position_info_cb, query,
+		"InstanceID", G_TYPE_INT, 0, NULL);
+
+	query = prv_sync_query_new(device, proxies->av_proxy,
+				   "GetCurrentTransportActions");
+	query->action = gupnp_service_proxy_begin_action(
+		query->proxy, query->name, prv_sync_transport_actions_cb,
+		query, "InstanceID", G_TYPE_INT, 0, NULL);
+
+	query = prv_sync_query_new(device, proxies->cm_proxy,
+				   "GetProtocolInfo");
+	query->action = gupnp_service_proxy_begin_action(
+		query->proxy, query->name, prv_sync_protocol_info_cb, query,
+		NULL);
+
+	if (proxies->rc_proxy) {
+		query = prv_sync_query_new(device, proxies->rc_proxy,
+					   "GetVolume");
+		query->action = gupnp_service_proxy_begin_action(
+			query->proxy, query->name, prv_sync_volume_cb, query,
+			"InstanceID", G_TYPE_INT, 0,
+			"Channel", G_TYPE_STRING, "Master", NULL);
+
+		query = prv_sync_query_new(device, proxies->rc_proxy,
+					   "GetMute");
+		query->action = gupnp_service_proxy_begin_action(
+			query->proxy, query->name, prv_sync_mute_cb, query,
+			"InstanceID", G_TYPE_INT, 0,
+			"Channel", G_TYPE_STRING, "Master", NULL);
+	}
+
+on_exit:
+
+	return;
+}
+
+static void prv_waiter_cancelled(GCancellable *cancellable,
+				 gpointer user_data)
+{
+	rsu_device_waiter_t *waiter = user_data;
+	rsu_async_cb_data_t *cb_data = waiter->cb_data;
+
+	(void) g_ptr_array_remove_fast(cb_data->device->sync_waiters, waiter);
+	g_free(waiter);
+
+	cb_data->error = g_error_new(RSU_ERROR, RSU_ERROR_CANCELLED,
+				     "Operation cancelled.");
+	(void) g_idle_add(rsu_async_complete_task, cb_data);
+}
+
+static void prv_sync_and_resume(rsu_device_t *device,
+				rsu_async_cb_data_t *cb_data,
+				GCancellable *cancellable,
+				rsu_device_local_cb_t resume)
+{
+	rsu_device_waiter_t *waiter;
+
+	cb_data->cancellable = cancellable;
+
+	if (device->props.synced) {
+		resume(cb_data);
+		goto on_exit;
+	}
+
+	waiter = g_new(rsu_device_waiter_t, 1);
+	waiter->cb_data = cb_data;
+	waiter->resume = resume;
+	g_ptr_array_add(device->sync_waiters, waiter);
+
+	cb_data->cancel_id =
+		g_cancellable_connect(cancellable,
+				      G_CALLBACK(prv_waiter_cancelled),
+				      waiter, NULL);
+
+	rsu_device_sync(device);
+
+on_exit:
+
+	return;
 }
 
 static void prv_complete_get_prop(rsu_async_cb_data_t *cb_data)
@@ -1003,6 +2114,11 @@ static void prv_complete_get_props(rsu_async_cb_data_t *cb_data)
 	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
 }
 
+static void prv_resume_get_all_props(rsu_async_cb_data_t *cb_data)
+{
+	prv_get_position_info(cb_data->cancellable, cb_data);
+}
+
 void rsu_device_get_prop(rsu_device_t *device, rsu_task_t *task,
 			 GCancellable *cancellable,
 			 rsu_upnp_task_complete_t cb,
@@ -1035,11 +2151,8 @@ void rsu_device_get_prop(rsu_device_t *device, rsu_task_t *task,
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
 						device);
 
-		if (!device->props.synced)
-			prv_props_update(device, task);
-
-		prv_get_prop(cb_data);
-		(void) g_idle_add(rsu_async_complete_task, cb_data);
+		prv_sync_and_resume(device, cb_data, cancellable,
+				    prv_complete_get_prop);
 	}
 }
 
@@ -1052,9 +2165,6 @@ void rsu_device_get_all_props(rsu_device_t *device, rsu_task_t *task,
 	rsu_task_get_props_t *get_props = &task->ut.get_props;
 	rsu_device_data_t *device_cb_data;
 
-	if (!device->props.synced)
-		prv_props_update(device, task);
-
 	if ((!strcmp(get_props->interface_name, RSU_INTERFACE_PLAYER) ||
 	     !strcmp(get_props->interface_name, ""))) {
 
@@ -1065,17 +2175,310 @@ void rsu_device_get_all_props(rsu_device_t *device, rsu_task_t *task,
 		device_cb_data->local_cb = prv_complete_get_props;
 
 		cb_data = rsu_async_cb_data_new(task, cb, user_data,
-						device_cb_data, NULL,
+						device_cb_data, g_free,
 						device);
 
-		prv_get_position_info(cancellable, cb_data);
+		prv_sync_and_resume(device, cb_data, cancellable,
+				    prv_resume_get_all_props);
 	} else {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
 					device);
 
-		prv_get_props(cb_data);
-		(void) g_idle_add(rsu_async_complete_task, cb_data);
+		prv_sync_and_resume(device, cb_data, cancellable,
+				    prv_complete_get_props);
+	}
+}
+
+static void prv_write_prop_cb(GUPnPServiceProxy *proxy,
+			      GUPnPServiceProxyAction *action,
+			      gpointer user_data)
+{
+	rsu_device_write_t *write = user_data;
+	GError *upnp_error = NULL;
+
+	/* The client was answered when the value was set, so failures can
+	   only be logged.  A rejected value changes nothing on the
+	   renderer, so no event will correct the cache.  The last value
+	   the renderer confirmed is put back instead, unless a newer
+	   value is about to be sent. */
+
+	if (gupnp_service_proxy_end_action(proxy, action, &upnp_error,
+					   NULL)) {
+		prv_write_confirm(write, write->sent);
+	} else {
+		RSU_LOG_WARNING("Unable to set %s of %s: %s",
+				write->prop_name, write->device->path,
+				upnp_error->message);
+		g_error_free(upnp_error);
+
+		if (!write->pending && write->confirmed)
+			write->restore(write);
 	}
+
+	g_variant_unref(write->sent);
+	write->sent = NULL;
+	g_object_unref(write->proxy);
+	write->proxy = NULL;
+	write->action = NULL;
+
+	if (write->pending)
+		write->send(write);
+}
+
+static void prv_write_prop(rsu_device_write_t *write, GVariant *value)
+{
+	if (write->pending)
+		g_variant_unref(write->pending);
+
+	write->pending = g_variant_ref_sink(value);
+
+	if (!write->action)
+		write->send(write);
+}
+
+static void prv_write_take_pending(rsu_device_write_t *write)
+{
+	if (write->sent)
+		g_variant_unref(write->sent);
+
+	write->sent = write->pending;
+	write->pending = NULL;
+}
+
+static void prv_send_volume(rsu_device_write_t *write)
+{
+	rsu_device_context_t *context;
+	gint volume = g_variant_get_int32(write->pending);
+
+	prv_write_take_pending(write);
+
+	context = rsu_device_get_context(write->device);
+	if (!context->service_proxies.rc_proxy)
+		goto on_exit;
+
+	write->proxy = g_object_ref(context->service_proxies.rc_proxy);
+	write->action =
+		gupnp_service_proxy_begin_action(write->proxy,
+						 "SetVolume",
+						 prv_write_prop_cb,
+						 write,
+						 "InstanceID", G_TYPE_INT, 0,
+						 "Channel", G_TYPE_STRING,
+						 "Master",
+						 "DesiredVolume", G_TYPE_INT,
+						 volume,
+						 NULL);
+
+on_exit:
+
+	return;
+}
+
+static gboolean prv_is_playing(rsu_device_t *device)
+{
+	GVariant *val;
+
+	val = g_hash_table_lookup(device->props.player_props,
+				  RSU_INTERFACE_PROP_PLAYBACK_STATUS);
+
+	return val && !strcmp(g_variant_get_string(val, NULL), "Playing");
+}
+
+static void prv_send_rate(rsu_device_write_t *write)
+{
+	rsu_device_context_t *context;
+	gchar speed[RSU_SPEED_BUFFER_SIZE];
+
+	prv_format_transport_speed(g_variant_get_double(write->pending),
+				   speed);
+	prv_write_take_pending(write);
+
+	/* The renderer may have been paused or stopped while an earlier
+	   rate was being sent.  The cached rate is used by the next Play
+	   instead. */
+
+	if (!prv_is_playing(write->device))
+		goto on_exit;
+
+	context = rsu_device_get_context(write->device);
+	write->proxy = g_object_ref(context->service_proxies.av_proxy);
+	write->action =
+		gupnp_service_proxy_begin_action(write->proxy,
+						 "Play",
+						 prv_write_prop_cb,
+						 write,
+						 "InstanceID", G_TYPE_INT, 0,
+						 "Speed", G_TYPE_STRING, speed,
+						 NULL);
+
+on_exit:
+
+	return;
+}
+
+static void prv_restore_volume(rsu_device_write_t *write)
+{
+	write->device->volume = g_variant_get_int32(write->confirmed);
+	prv_update_volume(write->device);
+}
+
+static void prv_restore_rate(rsu_device_write_t *write)
+{
+	g_hash_table_insert(write->device->props.player_props,
+			    RSU_INTERFACE_PROP_RATE,
+			    g_variant_ref(write->confirmed));
+}
+
+static void prv_set_volume(rsu_device_t *device, GVariant *value,
+			   GError **error)
+{
+	rsu_device_context_t *context;
+	gdouble volume;
+
+	context = rsu_device_get_context(device);
+	if (!context->service_proxies.rc_proxy) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_NOT_SUPPORTED,
+				     "Renderer does not support volume "
+				     "control");
+		goto on_error;
+	}
+
+	if (!g_variant_is_of_type(value, G_VARIANT_TYPE_DOUBLE)) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+				     "Volume must be a double");
+		goto on_error;
+	}
+
+	volume = CLAMP(g_variant_get_double(value), 0.0, 1.0);
+
+	device->volume = device->volume_min +
+		(gint) (volume * (device->volume_max - device->volume_min) +
+			0.5);
+	prv_update_volume(device);
+
+	prv_write_prop(&device->volume_write,
+		       g_variant_new_int32(device->volume));
+
+on_error:
+
+	return;
+}
+
+static gdouble prv_nearest_play_speed(rsu_device_t *device, gdouble rate)
+{
+	gdouble speed;
+	gdouble retval = rate;
+	gdouble distance = G_MAXDOUBLE;
+	unsigned int i;
+
+	/* Renderers reject any TransportPlaySpeed not listed in their
+	   SCPD, so the rate is rounded to the closest one they accept */
+
+	for (i = 0; i < device->play_speeds->len; ++i) {
+		speed = g_array_index(device->play_speeds, gdouble, i);
+		if (ABS(speed - rate) < distance) {
+			distance = ABS(speed - rate);
+			retval = speed;
+		}
+	}
+
+	return retval;
+}
+
+static void prv_set_rate(rsu_device_t *device, GVariant *value,
+			 GError **error)
+{
+	GVariant *val;
+	gdouble rate;
+	gdouble min_rate;
+	gdouble max_rate;
+
+	if (!g_variant_is_of_type(value, G_VARIANT_TYPE_DOUBLE)) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+				     "Rate must be a double");
+		goto on_error;
+	}
+
+	rate = g_variant_get_double(value);
+
+	val = g_hash_table_lookup(device->props.player_props,
+				  RSU_INTERFACE_PROP_MINIMUM_RATE);
+	min_rate = val ? g_variant_get_double(val) : 1.0;
+
+	val = g_hash_table_lookup(device->props.player_props,
+				  RSU_INTERFACE_PROP_MAXIMUM_RATE);
+	max_rate = val ? g_variant_get_double(val) : 1.0;
+
+	if (rate == 0.0 || rate < min_rate || rate > max_rate) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+				     "Rate must be non zero and between "
+				     "MinimumRate and MaximumRate");
+		goto on_error;
+	}
+
+	rate = prv_nearest_play_speed(device, rate);
+
+	g_hash_table_insert(device->props.player_props,
+			    RSU_INTERFACE_PROP_RATE,
+			    g_variant_ref_sink(g_variant_new_double(rate)));
+
+	/* Play(Speed) would start a stopped or paused renderer, so the
+	   new rate is only sent straight away if it is already playing.
+	   Otherwise it is used by the next Play. */
+
+	if (prv_is_playing(device))
+		prv_write_prop(&device->rate_write,
+			       g_variant_new_double(rate));
+
+on_error:
+
+	return;
+}
+
+static void prv_complete_set_prop(rsu_async_cb_data_t *cb_data)
+{
+	rsu_device_t *device = cb_data->device;
+	rsu_task_set_prop_t *set_prop = &cb_data->task->ut.set_prop;
+
+	/* The cache is updated and the client answered straight away.
+	   The value is sent to the renderer in the background. */
+
+	if (strcmp(set_prop->interface_name, RSU_INTERFACE_PLAYER) &&
+	    strcmp(set_prop->interface_name, "")) {
+		cb_data->error = g_error_new(RSU_ERROR,
+					     RSU_ERROR_UNKNOWN_INTERFACE,
+					     "Unknown Interface");
+		goto on_error;
+	}
+
+	if (!strcmp(set_prop->prop_name, RSU_INTERFACE_PROP_VOLUME))
+		prv_set_volume(device, set_prop->params, &cb_data->error);
+	else if (!strcmp(set_prop->prop_name, RSU_INTERFACE_PROP_RATE))
+		prv_set_rate(device, set_prop->params, &cb_data->error);
+	else
+		cb_data->error = g_error_new(RSU_ERROR,
+					     RSU_ERROR_UNKNOWN_PROPERTY,
+					     "Property not defined for object "
+					     "or read only");
+
+on_error:
+
+	(void) g_idle_add(rsu_async_complete_task, cb_data);
+	g_cancellable_disconnect(cb_data->cancellable, cb_data->cancel_id);
+}
+
+void rsu_device_set_prop(rsu_device_t *device, rsu_task_t *task,
+			 GCancellable *cancellable,
+			 rsu_upnp_task_complete_t cb,
+			 void *user_data)
+{
+	rsu_async_cb_data_t *cb_data;
+
+	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+					device);
+
+	prv_sync_and_resume(device, cb_data, cancellable,
+			    prv_complete_set_prop);
 }
 
 static void prv_simple_call_cb(GUPnPServiceProxy *proxy,
@@ -1105,11 +2508,18 @@ void rsu_device_play(rsu_device_t *device, rsu_task_t *task,
 {
 	rsu_device_context_t *context;
 	rsu_async_cb_data_t *cb_data;
+	GVariant *rate;
+	gchar speed[RSU_SPEED_BUFFER_SIZE];
 
 	context = rsu_device_get_context(device);
 	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
 					device);
 
+	rate = g_hash_table_lookup(device->props.player_props,
+				   RSU_INTERFACE_PROP_RATE);
+	prv_format_transport_speed(rate ? g_variant_get_double(rate) : 1.0,
+				   speed);
+
 	cb_data->cancel_id =
 		g_cancellable_connect(cancellable,
 				      G_CALLBACK(rsu_async_task_cancelled),
@@ -1122,7 +2532,7 @@ void rsu_device_play(rsu_device_t *device, rsu_task_t *task,
 						 prv_simple_call_cb,
 						 cb_data,
 						 "InstanceID", G_TYPE_INT, 0,
-						 "Speed", G_TYPE_STRING, "1",
+						 "Speed", G_TYPE_STRING, speed,
 						 NULL);
 }
 
@@ -1246,13 +2656,13 @@ static void prv_device_set_position(rsu_device_t *device, rsu_task_t *task,
 	rsu_device_context_t *context;
 	rsu_async_cb_data_t *cb_data;
 	rsu_task_seek_t *seek_data = &task->ut.seek;
-	gchar *position;
+	gchar position[RSU_DURATION_BUFFER_SIZE];
 
 	context = rsu_device_get_context(device);
 	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
 					device);
 
-	position = prv_int64_to_duration(seek_data->position);
+	rsu_duration_from_int64(seek_data->position, position);
 
 	cb_data->cancel_id =
 		g_cancellable_connect(cancellable,
@@ -1271,8 +2681,6 @@ static void prv_device_set_position(rsu_device_t *device, rsu_task_t *task,
 						 "Target",
 						 G_TYPE_STRING, position,
 						 NULL);
-
-	g_free(position);
 }
 
 void rsu_device_seek(rsu_device_t *device, rsu_task_t *task,
@@ -1293,6 +2701,19 @@ void rsu_device_set_position(rsu_device_t *device, rsu_task_t *task,
 				cancellable, cb, user_data);
 }
 
+static void prv_host_uri_cb(const gchar *url, const GError *error,
+			    gpointer user_data)
+{
+	rsu_async_cb_data_t *cb_data = user_data;
+
+	if (url)
+		cb_data->result = g_variant_ref_sink(g_variant_new_string(url));
+	else
+		cb_data->error = g_error_copy(error);
+
+	(void) g_idle_add(rsu_async_complete_task, cb_data);
+}
+
 void rsu_device_host_uri(rsu_device_t *device, rsu_task_t *task,
 			 rsu_host_service_t *host_service,
 			 GCancellable *cancellable,
@@ -1302,24 +2723,19 @@ void rsu_device_host_uri(rsu_device_t *device, rsu_task_t *task,
 	rsu_device_context_t *context;
 	rsu_async_cb_data_t *cb_data;
 	rsu_task_host_uri_t *host_uri = &task->ut.host_uri;
-	gchar *url;
-	GError *error = NULL;
 
-	context = rsu_device_get_context(device);
-	url = rsu_host_service_add(host_service, context->ip_address,
-				   host_uri->client, host_uri->uri,
-				   &error);
+	/* The file is hosted in the background and the device may be
+	   lost in the meantime, so the callback data does not refer to
+	   it */
 
+	context = rsu_device_get_context(device);
 	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
-					device);
-	if (url) {
-		cb_data->result = g_variant_ref_sink(g_variant_new_string(url));
-		g_free(url);
-	} else {
-		cb_data->error  = error;
-	}
+					NULL);
 
-	(void) g_idle_add(rsu_async_complete_task, cb_data);
+	rsu_host_service_add(host_service, context->ip_address,
+			     host_uri->client, host_uri->uri,
+			     task->type == RSU_TASK_HOST_GROWING_URI,
+			     prv_host_uri_cb, cb_data);
 }
 
 void rsu_device_remove_uri(rsu_device_t *device, rsu_task_t *task,
@@ -1346,3 +2762,64 @@ void rsu_device_remove_uri(rsu_device_t *device, rsu_task_t *task,
 
 	(void) g_idle_add(rsu_async_complete_task, cb_data);
 }
+
+void rsu_device_update_uri(rsu_device_t *device, rsu_task_t *task,
+			   rsu_host_service_t *host_service,
+			   GCancellable *cancellable,
+			   rsu_upnp_task_complete_t cb,
+			   void *user_data)
+{
+	rsu_device_context_t *context;
+	rsu_async_cb_data_t *cb_data;
+	rsu_task_host_uri_t *host_uri = &task->ut.host_uri;
+
+	context = rsu_device_get_context(device);
+	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+					NULL);
+
+	rsu_host_service_update(host_service, context->ip_address,
+				host_uri->client, host_uri->uri,
+				prv_host_uri_cb, cb_data);
+}
+
+void rsu_device_host_fd(rsu_device_t *device, rsu_task_t *task,
+			rsu_host_service_t *host_service,
+			GCancellable *cancellable,
+			rsu_upnp_task_complete_t cb,
+			void *user_data)
+{
+	rsu_device_context_t *context;
+	rsu_async_cb_data_t *cb_data;
+	rsu_task_host_fd_t *host_fd = &task->ut.host_fd;
+
+	context = rsu_device_get_context(device);
+	cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+					NULL);
+
+	if (host_fd->fd < 0) {
+		cb_data->error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+					     "No file descriptor was passed");
+		(void) g_idle_add(rsu_async_complete_task, cb_data);
+		goto on_error;
+	}
+
+	if (!*host_fd->mime_type) {
+		cb_data->error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_MIME,
+					     "A MIME type must be specified");
+		(void) g_idle_add(rsu_async_complete_task, cb_data);
+		goto on_error;
+	}
+
+	/* The host service takes over the descriptor */
+
+	rsu_host_service_add_fd(host_service, context->ip_address,
+				host_fd->client, host_fd->fd,
+				host_fd->mime_type,
+				task->type == RSU_TASK_HOST_STREAM,
+				prv_host_uri_cb, cb_data);
+	host_fd->fd = -1;
+
+on_error:
+
+	return;
+}
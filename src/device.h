@@ -26,7 +26,11 @@
 #include <gio/gio.h>
 #include <glib.h>
 
+#include "device-cache.h"
 #include "host-service.h"
+#include "protocol-info.h"
+#include "scpd-cache.h"
+#include "settings.h"
 #include "upnp.h"
 
 typedef struct rsu_device_t_ rsu_device_t;
@@ -46,6 +50,27 @@ struct rsu_device_context_t_ {
 	rsu_device_t *device;
 };
 
+/* Writes of a property to a renderer are coalesced.  At most one
+   action is in flight per property and only the newest of the values
+   set in the meantime is sent once it completes.  confirmed is the
+   last value the renderer reported or accepted.  It is put back in
+   the cache if the renderer rejects a value. */
+
+typedef struct rsu_device_write_t_ rsu_device_write_t;
+typedef void (*rsu_device_write_send_t)(rsu_device_write_t *write);
+typedef void (*rsu_device_write_restore_t)(rsu_device_write_t *write);
+struct rsu_device_write_t_ {
+	rsu_device_t *device;
+	const gchar *prop_name;
+	rsu_device_write_send_t send;
+	rsu_device_write_restore_t restore;
+	GVariant *pending;
+	GVariant *sent;
+	GVariant *confirmed;
+	GUPnPServiceProxy *proxy;
+	GUPnPServiceProxyAction *action;
+};
+
 typedef struct rsu_props_t_ rsu_props_t;
 struct rsu_props_t_ {
 	GHashTable *root_props;
@@ -60,6 +85,32 @@ struct rsu_device_t_ {
 	GPtrArray *contexts;
 	gpointer current_task;
 	rsu_props_t props;
+	rsu_protocol_info_t *protocol_info;
+	rsu_protocol_info_index_t *protocol_info_index;
+	rsu_settings_context_t *settings;
+	gboolean subscribed;
+	guint idle_id;
+	guint subscribe_id;
+	gint64 subscribe_time;
+	guint subscription_retries;
+	guint subscription_failures;
+	gint volume;
+	gint volume_min;
+	gint volume_max;
+	rsu_scpd_cache_t *scpd_cache;
+	rsu_device_cache_t *device_cache;
+	rsu_scpd_request_t *av_scpd;
+	rsu_scpd_request_t *rc_scpd;
+	GArray *play_speeds;
+	rsu_device_write_t volume_write;
+	rsu_device_write_t rate_write;
+	GPtrArray *sync_queries;
+	GPtrArray *sync_waiters;
+
+	/* Names of the state variables received in events since the
+	   current sync started.  Replies to its queries are older than
+	   these and do not overwrite them. */
+	GHashTable *evented;
 };
 
 gboolean rsu_device_new(GDBusConnection *connection,
@@ -67,6 +118,10 @@ gboolean rsu_device_new(GDBusConnection *connection,
 			const gchar *ip_address,
 			guint counter,
 			rsu_interface_info_t *interface_info,
+			rsu_protocol_info_index_t *protocol_info_index,
+			rsu_scpd_cache_t *scpd_cache,
+			rsu_device_cache_t *device_cache,
+			rsu_settings_context_t *settings,
 			void *user_data,
 			rsu_device_t **device);
 
@@ -77,6 +132,13 @@ void rsu_device_append_new_context(rsu_device_t *device,
 				   GUPnPDeviceProxy *proxy);
 rsu_device_t *rsu_device_from_path(const gchar *path, GHashTable *device_list);
 rsu_device_context_t *rsu_device_get_context(rsu_device_t *device);
+void rsu_device_touch(rsu_device_t *device);
+void rsu_device_sync(rsu_device_t *device);
+
+void rsu_device_save_props(rsu_device_t *device, GVariant **root_props,
+			   GVariant **player_props);
+void rsu_device_restore_props(rsu_device_t *device, GVariant *root_props,
+			      GVariant *player_props);
 
 void rsu_device_get_prop(rsu_device_t *device, rsu_task_t *task,
 			GCancellable *cancellable,
@@ -86,6 +148,10 @@ void rsu_device_get_all_props(rsu_device_t *device, rsu_task_t *task,
 			      GCancellable *cancellable,
 			      rsu_upnp_task_complete_t cb,
 			      void *user_data);
+void rsu_device_set_prop(rsu_device_t *device, rsu_task_t *task,
+			 GCancellable *cancellable,
+			 rsu_upnp_task_complete_t cb,
+			 void *user_data);
 void rsu_device_play(rsu_device_t *device, rsu_task_t *task,
 		     GCancellable *cancellable,
 		     rsu_upnp_task_complete_t cb,
@@ -132,5 +198,15 @@ void rsu_device_remove_uri(rsu_device_t *device, rsu_task_t *task,
 			   GCancellable *cancellable,
 			   rsu_upnp_task_complete_t cb,
 			   void *user_data);
+void rsu_device_update_uri(rsu_device_t *device, rsu_task_t *task,
+			   rsu_host_service_t *host_service,
+			   GCancellable *cancellable,
+			   rsu_upnp_task_complete_t cb,
+			   void *user_data);
+void rsu_device_host_fd(rsu_device_t *device, rsu_task_t *task,
+			rsu_host_service_t *host_service,
+			GCancellable *cancellable,
+			rsu_upnp_task_complete_t cb,
+			void *user_data);
 
 #endif
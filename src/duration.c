@@ -0,0 +1,186 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#include "duration.h"
+
+/* The largest number of hours that can be represented in microseconds
+   by a gint64 */
+#define RSU_DURATION_MAX_HOURS G_GUINT64_CONSTANT(2562047788)
+
+static const gchar *prv_parse_digits(const gchar *ptr, guint max_digits,
+				     guint64 *value, guint *digits)
+{
+	guint64 val = 0;
+	guint count = 0;
+
+	while (g_ascii_isdigit(*ptr)) {
+		if (count < max_digits)
+			val = val * 10 + (*ptr - '0');
+		++count;
+		++ptr;
+	}
+
+	*value = val;
+	*digits = count;
+
+	return ptr;
+}
+
+gint64 rsu_duration_to_int64(const gchar *duration)
+{
+	const gchar *ptr = duration;
+	gboolean negative = FALSE;
+	guint64 hours;
+	guint64 minutes;
+	guint64 seconds;
+	guint64 num = 0;
+	guint64 den;
+	guint64 micro = 0;
+	guint digits;
+	guint num_digits;
+	guint64 pos;
+
+	/* Parses H+:MM:SS[.F+|.F0/F1] without allocating memory.  Values
+	   that cannot be parsed, e.g., NOT_IMPLEMENTED, or whose minutes
+	   or seconds are out of range, are returned as 0 */
+
+	while (g_ascii_isspace(*ptr))
+		++ptr;
+
+	if (*ptr == '-') {
+		negative = TRUE;
+		++ptr;
+	} else if (*ptr == '+') {
+		++ptr;
+	}
+
+	ptr = prv_parse_digits(ptr, 11, &hours, &digits);
+	if (digits == 0 || digits > 10 || hours > RSU_DURATION_MAX_HOURS ||
+	    *ptr++ != ':')
+		goto on_error;
+
+	ptr = prv_parse_digits(ptr, 2, &minutes, &digits);
+	if (digits == 0 || digits > 2 || minutes > 59 || *ptr++ != ':')
+		goto on_error;
+
+	ptr = prv_parse_digits(ptr, 2, &seconds, &digits);
+	if (digits == 0 || digits > 2 || seconds > 59)
+		goto on_error;
+
+	if (*ptr == '.') {
+		ptr = prv_parse_digits(ptr + 1, 18, &num, &num_digits);
+		if (num_digits == 0)
+			goto on_error;
+
+		if (*ptr == '/') {
+			ptr = prv_parse_digits(ptr + 1, 12, &den, &digits);
+			if (digits == 0 || digits > 12 || num_digits > 12 ||
+			    den == 0 || num >= den)
+				goto on_error;
+
+			micro = (num * 1000000 + den / 2) / den;
+		} else {
+			if (num_digits > 18)
+				num_digits = 18;
+
+			micro = num;
+			for (; num_digits < 6; ++num_digits)
+				micro *= 10;
+			for (; num_digits > 6; --num_digits)
+				micro /= 10;
+		}
+	}
+
+	while (g_ascii_isspace(*ptr))
+		++ptr;
+
+	if (*ptr)
+		goto on_error;
+
+	pos = ((hours * 60 + minutes) * 60 + seconds) * 1000000 + micro;
+	if (pos > G_MAXINT64)
+		goto on_error;
+
+	return negative ? -(gint64) pos : (gint64) pos;
+
+on_error:
+
+	return 0;
+}
+
+static gchar *prv_format_digits(gchar *ptr, guint64 value, guint min_digits)
+{
+	gchar digits[20];
+	guint count = 0;
+
+	do {
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	for (; count < min_digits; --min_digits)
+		*ptr++ = '0';
+
+	while (count)
+		*ptr++ = digits[--count];
+
+	return ptr;
+}
+
+void rsu_duration_from_int64(gint64 micro_seconds, gchar *buffer)
+{
+	gchar *ptr = buffer;
+	guint64 abs_micro;
+	guint64 seconds;
+	guint64 fraction;
+	guint fraction_digits = 6;
+
+	if (micro_seconds < 0) {
+		*ptr++ = '-';
+		abs_micro = -(guint64) micro_seconds;
+	} else {
+		abs_micro = micro_seconds;
+	}
+
+	seconds = abs_micro / 1000000;
+	fraction = abs_micro % 1000000;
+
+	ptr = prv_format_digits(ptr, seconds / 3600, 2);
+	*ptr++ = ':';
+	ptr = prv_format_digits(ptr, (seconds / 60) % 60, 2);
+	*ptr++ = ':';
+	ptr = prv_format_digits(ptr, seconds % 60, 2);
+
+	if (fraction) {
+		while (fraction % 10 == 0) {
+			fraction /= 10;
+			--fraction_digits;
+		}
+
+		*ptr++ = '.';
+		ptr = prv_format_digits(ptr, fraction, fraction_digits);
+	}
+
+	*ptr = 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#ifndef RSU_DURATION_H__
+#define RSU_DURATION_H__
+
+#include <glib.h>
+
+/* Large enough for "-" + 10 hour digits + ":MM:SS" + ".FFFFFF" + '\0' */
+#define RSU_DURATION_BUFFER_SIZE 32
+
+/* Parses a UPnP duration, [+|-]H+:MM:SS[.F+|.F0/F1], into microseconds.
+   Strings that cannot be parsed, e.g., NOT_IMPLEMENTED, yield 0. */
+
+gint64 rsu_duration_to_int64(const gchar *duration);
+
+/* buffer must be at least RSU_DURATION_BUFFER_SIZE bytes long */
+
+void rsu_duration_from_int64(gint64 micro_seconds, gchar *buffer);
+
+#endif
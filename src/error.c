@@ -41,7 +41,8 @@ static const GDBusErrorEntry g_error_entries[] = {
 	{ RSU_ERROR_NOT_SUPPORTED, RSU_SERVICE".NotSupported" },
 	{ RSU_ERROR_LOST_OBJECT, RSU_SERVICE".LostObject" },
 	{ RSU_ERROR_BAD_MIME, RSU_SERVICE".BadMime" },
-	{ RSU_ERROR_HOST_FAILED, RSU_SERVICE".HostFailed" }
+	{ RSU_ERROR_HOST_FAILED, RSU_SERVICE".HostFailed" },
+	{ RSU_ERROR_BAD_VALUE, RSU_SERVICE".BadValue" }
 };
 
 GQuark rsu_error_quark(void)
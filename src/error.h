@@ -39,7 +39,8 @@ enum rsu_error_t_ {
 	RSU_ERROR_NOT_SUPPORTED,
 	RSU_ERROR_LOST_OBJECT,
 	RSU_ERROR_BAD_MIME,
-	RSU_ERROR_HOST_FAILED
+	RSU_ERROR_HOST_FAILED,
+	RSU_ERROR_BAD_VALUE
 };
 typedef enum rsu_error_t_ rsu_error_t;
 
@@ -21,215 +21,1858 @@
  */
 
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <libsoup/soup.h>
 
 #include "error.h"
 #include "host-service.h"
+#include "log.h"
+#include "mime-cache.h"
 
 #define HOST_SERVICE_ROOT "/rendererserviceupnp"
 
+/* The address the shared server listens on when one server is used
+   for all interfaces */
+#define RSU_HOST_ANY_INTERFACE "0.0.0.0"
+
+/* Files larger than this are streamed from disk in chunks rather than
+   mapped into memory in their entirety */
+#define RSU_HOST_STREAM_THRESHOLD (16 * 1024 * 1024)
+#define RSU_HOST_STREAM_CHUNK_SIZE (64 * 1024)
+
+/* How far beyond the requested range the kernel is asked to read when
+   a file is being played through from start to finish */
+#define RSU_HOST_READ_AHEAD (1024 * 1024)
+
+/* Number of renderers whose position in a file is remembered.  The
+   positions are forgotten when a new renderer would exceed this. */
+#define RSU_HOST_MAX_CLIENT_OFFSETS 16
+
+/* Amount of a live stream kept in memory for the renderers reading
+   it.  This is how far the slowest can fall behind the fastest. */
+#define RSU_HOST_RING_SIZE (4 * 1024 * 1024)
+
+/* A growing file that has not been written to for this many seconds
+   is treated as closed, in case its writer never closes it or had
+   already closed it when it was hosted */
+#define RSU_HOST_GROWING_IDLE_TIMEOUT 30
+
+/* Large enough for a burst of events on the files being followed */
+#define RSU_HOST_INOTIFY_BUFFER_SIZE (16 * 1024)
+
+typedef struct rsu_host_server_t_ rsu_host_server_t;
+
 typedef struct rsu_host_file_t_ rsu_host_file_t;
 struct rsu_host_file_t_ {
 	unsigned int id;
-	GPtrArray *clients;
+	rsu_host_server_t *server;
+	GHashTable *clients;
+	gchar *mime_type;
+	gchar *path;
+	gchar *file;
+	int fd;
+	gboolean live;
+	gboolean growing;
+	const gchar *transfer_mode;
+	gchar *content_features;
+};
+
+/* The HTTP servers run in a worker thread with its own main context so
+   that streaming does not hold up D-Bus and UPnP traffic on the main
+   thread.  The main thread keeps track of hosted files and their
+   clients.  It hands each change over to the worker through a queue
+   of commands and never touches a listener or an entry once it has
+   been handed over. */
+
+typedef struct rsu_host_ring_t_ rsu_host_ring_t;
+
+typedef struct rsu_host_entry_t_ rsu_host_entry_t;
+struct rsu_host_entry_t_ {
+	guint ref_count;
+	rsu_host_service_t *service;
+	gchar *file;
+	int fd;
+	gboolean live;
+	rsu_host_ring_t *ring;
+	gboolean growing;
+	int wd;
+	gboolean closed;
+	GSource *idle_timeout;
+	gint64 modified_time;
+	GPtrArray *tails;
 	gchar *mime_type;
+	const gchar *transfer_mode;
+	gchar *content_features;
 	GMappedFile *mapped_file;
 	unsigned int mapped_count;
+	struct timespec mapped_mtime;
+	ino_t mapped_ino;
+	GList *idle_link;
+	GHashTable *next_offsets;
+	unsigned int version;
+};
+
+/* A live stream is read once, as fast as its slowest reader allows
+   or as fast as it comes if slow readers are dropped, into a ring
+   buffer from which every request for it is served at its own
+   position.  Positions count bytes from the start of the stream. */
+
+struct rsu_host_ring_t_ {
+	rsu_host_service_t *service;
+	GIOChannel *channel;
+	GSource *watch;
+	guint8 *data;
+	guint64 head;
+	gboolean eof;
+	GPtrArray *readers;
+};
+
+typedef struct rsu_host_reader_t_ rsu_host_reader_t;
+struct rsu_host_reader_t_ {
+	rsu_host_ring_t *ring;
+	rsu_host_entry_t *entry;
+	SoupServer *server;
+	SoupMessage *msg;
+	SoupClientContext *client;
+	guint64 position;
+	gboolean writing;
+	gboolean complete;
+};
+
+/* A file that is still being written is sent as far as it has got,
+   and then followed, with inotify telling the worker when more has
+   been written.  The response ends once the writer closes the file. */
+
+typedef struct rsu_host_tail_t_ rsu_host_tail_t;
+struct rsu_host_tail_t_ {
+	rsu_host_entry_t *entry;
+	SoupServer *server;
+	SoupMessage *msg;
+	int fd;
+	goffset position;
+	gboolean writing;
+	gboolean complete;
+};
+
+typedef struct rsu_host_listener_t_ rsu_host_listener_t;
+struct rsu_host_listener_t_ {
+	SoupServer *soup_server;
+	GHashTable *urls;
+};
+
+/* Hosting a file involves disk access and possibly creating a server,
+   which can both block.  This is done by the worker thread, which
+   hands the job back to the main thread once it is finished. */
+
+typedef struct rsu_host_job_t_ rsu_host_job_t;
+struct rsu_host_job_t_ {
+	rsu_host_service_t *service;
+	gchar *device_if;
+	gchar *client;
+	gchar *file;
+	int fd;
+	gchar *mime_type;
+	gboolean live;
+	gboolean growing;
+	gboolean new_listener;
+	gboolean update;
+	gboolean cancelled;
+	rsu_host_listener_t *listener;
+	guint port;
+	rsu_host_file_t *hf;
+	GError *error;
+	rsu_host_service_add_cb_t cb;
+	gpointer user_data;
+};
+
+typedef enum rsu_host_command_type_t_ rsu_host_command_type_t;
+enum rsu_host_command_type_t_ {
+	RSU_HOST_COMMAND_PROBE,
+	RSU_HOST_COMMAND_ADD,
+	RSU_HOST_COMMAND_REMOVE,
+	RSU_HOST_COMMAND_UPDATE,
+	RSU_HOST_COMMAND_DELETE,
+	RSU_HOST_COMMAND_QUIT
+};
+
+typedef struct rsu_host_command_t_ rsu_host_command_t;
+struct rsu_host_command_t_ {
+	rsu_host_command_type_t type;
+	rsu_host_listener_t *listener;
 	gchar *path;
+	rsu_host_entry_t *entry;
+	rsu_host_job_t *job;
+};
+
+/* A streamed response is a sequence of segments, each of which is an
+   optional header, used for the parts of multipart/byteranges
+   responses, followed by a range of the file */
+
+typedef struct rsu_host_segment_t_ rsu_host_segment_t;
+struct rsu_host_segment_t_ {
+	gchar *header;
+	goffset offset;
+	goffset length;
+};
+
+typedef struct rsu_host_stream_t_ rsu_host_stream_t;
+struct rsu_host_stream_t_ {
+	int fd;
+	SoupClientContext *client;
+	GArray *segments;
+	unsigned int current;
+};
+
+typedef enum rsu_host_body_t_ rsu_host_body_t;
+enum rsu_host_body_t_ {
+	RSU_HOST_BODY_NONE,
+	RSU_HOST_BODY_MAPPED,
+	RSU_HOST_BODY_STREAMED
 };
 
-typedef struct rsu_host_server_t_ rsu_host_server_t;
 struct rsu_host_server_t_ {
+	rsu_host_service_t *service;
+	gchar *device_if;
 	GHashTable *files;
-	SoupServer *soup_server;
+	rsu_host_listener_t *listener;
+	guint port;
 	unsigned int counter;
 };
 
 struct rsu_host_service_t_ {
 	GHashTable *servers;
+
+	/* Indexes the files hosted for each client by client name, so
+	   that a client's files can be found without searching every
+	   server */
+	GHashTable *clients;
+
+	/* Jobs handed to the worker and not yet finished, so that those
+	   of a client that goes away can be dropped */
+	GPtrArray *jobs;
+
+	gboolean shared_listener;
+	gboolean drop_slow_readers;
+	GMainContext *context;
+	GMainLoop *loop;
+	GAsyncQueue *commands;
+	GThread *thread;
+	rsu_mime_cache_t *mime_cache;
+
+	/* Mappings that no request is reading are kept, most recently
+	   used first, until they no longer fit in the budget */
+	GQueue *idle_mappings;
+	goffset mapped_bytes;
+	goffset mapping_budget;
+
+	/* Created when the first growing file is hosted.  The entries
+	   following each file are indexed by watch descriptor. */
+	int inotify_fd;
+	GSource *inotify_watch;
+	GHashTable *followed;
 };
 
-static void prv_host_file_delete(gpointer host_file)
+static void prv_host_job_run(rsu_host_job_t *job);
+
+static void prv_host_file_delete(gpointer host_file)
+{
+	rsu_host_file_t *hf = host_file;
+
+	if (hf) {
+		g_free(hf->path);
+		g_free(hf->file);
+		g_free(hf->content_features);
+		g_hash_table_unref(hf->clients);
+
+		if (hf->fd >= 0)
+			(void) close(hf->fd);
+
+		g_free(hf->mime_type);
+		g_free(hf);
+	}
+}
+
+static rsu_host_file_t *prv_host_file_new(rsu_mime_cache_t *mime_cache,
+					  const gchar *file, gboolean growing,
+					  GError **error)
+{
+	rsu_host_file_t *hf = NULL;
+	const rsu_mime_type_t *type;
+	rsu_mime_type_t growing_type;
+	struct stat st;
+
+	/* Runs in the worker thread, which owns the MIME cache */
+
+	if (stat(file, &st) || !S_ISREG(st.st_mode)) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_OBJECT_NOT_FOUND,
+				     "File %s does not exist or is not"
+				     " a regular file", file);
+		goto on_error;
+	}
+
+	type = rsu_mime_cache_lookup(mime_cache, file, error);
+	if (!type)
+		goto on_error;
+
+	hf = g_new0(rsu_host_file_t, 1);
+	hf->file = g_strdup(file);
+	hf->fd = -1;
+	hf->growing = growing;
+	hf->clients = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					    NULL);
+	hf->mime_type = g_strdup(type->mime_type);
+
+	/* Renderers cannot seek in a file whose length is not yet known */
+
+	if (growing) {
+		growing_type.mime_type = type->mime_type;
+		rsu_mime_type_set_dlna_headers(&growing_type, FALSE);
+		hf->transfer_mode = growing_type.transfer_mode;
+		hf->content_features = growing_type.content_features;
+	} else {
+		hf->transfer_mode = type->transfer_mode;
+		hf->content_features = g_strdup(type->content_features);
+	}
+
+on_error:
+
+	return hf;
+}
+
+static rsu_host_file_t *prv_host_file_new_from_fd(int fd,
+						  const gchar *mime_type,
+						  gboolean live,
+						  GError **error)
+{
+	rsu_host_file_t *hf = NULL;
+	rsu_mime_type_t type;
+	struct stat st;
+
+	/* Content passed by descriptor, such as a memfd, has no name to
+	   sniff, so the client supplies its MIME type.  A live stream
+	   can come from a pipe or a socket as well. */
+
+	if (fstat(fd, &st) || S_ISDIR(st.st_mode) ||
+	    (!live && !S_ISREG(st.st_mode))) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+				     "File descriptor does not refer to"
+				     " a regular file");
+		goto on_error;
+	}
+
+	type.mime_type = (gchar *) mime_type;
+	rsu_mime_type_set_dlna_headers(&type, !live);
+
+	hf = g_new0(rsu_host_file_t, 1);
+	hf->fd = fd;
+	hf->live = live;
+	hf->clients = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					    NULL);
+	hf->mime_type = g_strdup(mime_type);
+	hf->transfer_mode = type.transfer_mode;
+	hf->content_features = type.content_features;
+
+on_error:
+
+	return hf;
+}
+
+static rsu_host_entry_t *prv_host_entry_new(rsu_host_service_t *service,
+					    rsu_host_file_t *hf)
+{
+	rsu_host_entry_t *entry = g_new0(rsu_host_entry_t, 1);
+
+	entry->ref_count = 1;
+	entry->service = service;
+	entry->file = g_strdup(hf->file);
+	entry->fd = hf->fd >= 0 ? dup(hf->fd) : -1;
+	entry->live = hf->live;
+	entry->growing = hf->growing;
+	entry->wd = -1;
+	if (hf->growing)
+		entry->tails = g_ptr_array_new();
+	entry->mime_type = g_strdup(hf->mime_type);
+	entry->transfer_mode = hf->transfer_mode;
+	entry->content_features = g_strdup(hf->content_features);
+
+	return entry;
+}
+
+static void prv_host_entry_unmap(rsu_host_entry_t *entry)
+{
+	rsu_host_service_t *service = entry->service;
+
+	if (entry->idle_link) {
+		g_queue_delete_link(service->idle_mappings, entry->idle_link);
+		entry->idle_link = NULL;
+	}
+
+	service->mapped_bytes -= g_mapped_file_get_length(entry->mapped_file);
+	g_mapped_file_unref(entry->mapped_file);
+	entry->mapped_file = NULL;
+}
+
+static void prv_trim_mappings(rsu_host_service_t *service)
+{
+	rsu_host_entry_t *entry;
+
+	/* Mappings that are being read cannot be dropped, so the budget
+	   can be exceeded while many files are being served at once */
+
+	while (service->mapped_bytes > service->mapping_budget) {
+		entry = g_queue_peek_tail(service->idle_mappings);
+		if (!entry)
+			break;
+
+		RSU_LOG_DEBUG("Unmapping %s", entry->file);
+
+		prv_host_entry_unmap(entry);
+	}
+}
+
+static void prv_host_entry_unref(gpointer host_entry)
+{
+	rsu_host_entry_t *entry = host_entry;
+
+	if (entry && --entry->ref_count == 0) {
+		if (entry->mapped_file)
+			prv_host_entry_unmap(entry);
+
+		if (entry->fd >= 0)
+			(void) close(entry->fd);
+
+		if (entry->tails)
+			g_ptr_array_unref(entry->tails);
+
+		if (entry->next_offsets)
+			g_hash_table_unref(entry->next_offsets);
+
+		g_free(entry->file);
+		g_free(entry->mime_type);
+		g_free(entry->content_features);
+		g_free(entry);
+	}
+}
+
+static guint64 prv_host_ring_space(rsu_host_ring_t *ring)
+{
+	rsu_host_reader_t *reader;
+	guint64 tail = ring->head;
+	unsigned int i;
+
+	/* Unless slow readers are to be dropped, data is kept until the
+	   slowest reader has sent it */
+
+	if (!ring->service->drop_slow_readers)
+		for (i = 0; i < ring->readers->len; ++i) {
+			reader = g_ptr_array_index(ring->readers, i);
+			tail = MIN(tail, reader->position);
+		}
+
+	return RSU_HOST_RING_SIZE - (ring->head - tail);
+}
+
+static void prv_host_reader_feed(rsu_host_reader_t *reader)
+{
+	rsu_host_ring_t *ring = reader->ring;
+	SoupMessageBody *body = reader->msg->response_body;
+	gsize offset;
+	gsize size;
+
+	/* Only one chunk is handed to libsoup at a time.  It is copied,
+	   as its part of the ring may be overwritten before it is
+	   sent. */
+
+	if (reader->writing || reader->complete)
+		goto on_exit;
+
+	if (ring && reader->position < ring->head) {
+		offset = reader->position % RSU_HOST_RING_SIZE;
+		size = MIN(ring->head - reader->position,
+			   RSU_HOST_RING_SIZE - offset);
+		size = MIN(size, RSU_HOST_STREAM_CHUNK_SIZE);
+		soup_message_body_append(body, SOUP_MEMORY_COPY,
+					 ring->data + offset, size);
+		reader->position += size;
+		reader->writing = TRUE;
+	} else if (!ring || ring->eof) {
+		soup_message_body_complete(body);
+		reader->complete = TRUE;
+	} else {
+		goto on_exit;
+	}
+
+	soup_server_unpause_message(reader->server, reader->msg);
+
+on_exit:
+
+	return;
+}
+
+static void prv_host_reader_drop(rsu_host_reader_t *reader)
+{
+	RSU_LOG_WARNING("Renderer too far behind live stream %s.  "
+			"Closing connection", reader->entry->file);
+
+	reader->ring = NULL;
+	reader->complete = TRUE;
+	soup_socket_disconnect(soup_client_context_get_socket(reader->client));
+}
+
+static gboolean prv_host_ring_read_cb(GIOChannel *channel,
+				      GIOCondition condition,
+				      gpointer user_data)
+{
+	rsu_host_ring_t *ring = user_data;
+	rsu_host_reader_t *reader;
+	guint64 space;
+	gsize offset;
+	gssize count;
+	unsigned int i;
+	gboolean retval = TRUE;
+
+	space = prv_host_ring_space(ring);
+
+	if (space == 0) {
+		ring->watch = NULL;
+		retval = FALSE;
+		goto on_exit;
+	}
+
+	offset = ring->head % RSU_HOST_RING_SIZE;
+	count = read(g_io_channel_unix_get_fd(channel), ring->data + offset,
+		     MIN(space, RSU_HOST_RING_SIZE - offset));
+
+	if (count < 0 && (errno == EAGAIN || errno == EINTR))
+		goto on_exit;
+
+	if (count <= 0) {
+		ring->eof = TRUE;
+		ring->watch = NULL;
+		retval = FALSE;
+	} else {
+		ring->head += count;
+	}
+
+	i = 0;
+	while (i < ring->readers->len) {
+		reader = g_ptr_array_index(ring->readers, i);
+
+		if (reader->position + RSU_HOST_RING_SIZE < ring->head) {
+			g_ptr_array_remove_index_fast(ring->readers, i);
+			prv_host_reader_drop(reader);
+			continue;
+		}
+
+		prv_host_reader_feed(reader);
+		++i;
+	}
+
+on_exit:
+
+	return retval;
+}
+
+static void prv_host_ring_watch(rsu_host_ring_t *ring)
+{
+	/* Reading stops while the ring is full, and starts again once
+	   the slowest reader has made room */
+
+	if (ring->watch || ring->eof || prv_host_ring_space(ring) == 0)
+		goto on_exit;
+
+	ring->watch = g_io_create_watch(ring->channel,
+					G_IO_IN | G_IO_HUP | G_IO_ERR);
+	g_source_set_callback(ring->watch, (GSourceFunc) prv_host_ring_read_cb,
+			      ring, NULL);
+	(void) g_source_attach(ring->watch, ring->service->context);
+	g_source_unref(ring->watch);
+
+on_exit:
+
+	return;
+}
+
+static rsu_host_ring_t *prv_host_ring_new(rsu_host_service_t *service,
+					  int fd)
+{
+	rsu_host_ring_t *ring = g_new0(rsu_host_ring_t, 1);
+
+	ring->service = service;
+	ring->channel = g_io_channel_unix_new(fd);
+	(void) g_io_channel_set_flags(ring->channel, G_IO_FLAG_NONBLOCK, NULL);
+	ring->data = g_malloc(RSU_HOST_RING_SIZE);
+	ring->readers = g_ptr_array_new();
+
+	/* The stream is read even while nobody is listening so that it
+	   does not back up into the client */
+
+	prv_host_ring_watch(ring);
+
+	return ring;
+}
+
+static void prv_host_ring_delete(rsu_host_ring_t *ring)
+{
+	rsu_host_reader_t *reader;
+	unsigned int i;
+
+	if (ring->watch)
+		g_source_destroy(ring->watch);
+
+	/* Requests still reading the stream are ended cleanly once they
+	   have sent what they already have */
+
+	for (i = 0; i < ring->readers->len; ++i) {
+		reader = g_ptr_array_index(ring->readers, i);
+		reader->ring = NULL;
+		prv_host_reader_feed(reader);
+	}
+
+	g_ptr_array_unref(ring->readers);
+	g_io_channel_unref(ring->channel);
+	g_free(ring->data);
+	g_free(ring);
+}
+
+static void prv_host_tail_feed(rsu_host_tail_t *tail)
+{
+	SoupMessageBody *body = tail->msg->response_body;
+	gchar *buffer;
+	gssize count;
+
+	if (tail->writing || tail->complete)
+		goto on_exit;
+
+	buffer = g_malloc(RSU_HOST_STREAM_CHUNK_SIZE);
+	count = pread(tail->fd, buffer, RSU_HOST_STREAM_CHUNK_SIZE,
+		      tail->position);
+
+	if (count > 0) {
+		soup_message_body_append(body, SOUP_MEMORY_TAKE, buffer,
+					 count);
+		tail->position += count;
+		tail->writing = TRUE;
+	} else {
+		g_free(buffer);
+
+		/* Having caught up, the request waits for the writer
+		   unless the file has been closed */
+
+		if (count == 0 && !tail->entry->closed)
+			goto on_exit;
+
+		soup_message_body_complete(body);
+		tail->complete = TRUE;
+	}
+
+	soup_server_unpause_message(tail->server, tail->msg);
+
+on_exit:
+
+	return;
+}
+
+static void prv_host_entry_feed_tails(rsu_host_entry_t *entry)
+{
+	unsigned int i;
+
+	for (i = 0; i < entry->tails->len; ++i)
+		prv_host_tail_feed(g_ptr_array_index(entry->tails, i));
+}
+
+static void prv_host_entry_arm_idle(rsu_host_entry_t *entry,
+				    gint64 delay);
+
+static gboolean prv_host_entry_idle_cb(gpointer user_data)
+{
+	rsu_host_entry_t *entry = user_data;
+	gint64 timeout = RSU_HOST_GROWING_IDLE_TIMEOUT * G_USEC_PER_SEC;
+	gint64 idle;
+
+	/* The timer is not reset on every write.  Instead it goes round
+	   again for the remainder if the file has been written since it
+	   was armed. */
+
+	entry->idle_timeout = NULL;
+	idle = g_get_monotonic_time() - entry->modified_time;
+
+	if (idle < timeout) {
+		prv_host_entry_arm_idle(entry, timeout - idle);
+		goto on_exit;
+	}
+
+	RSU_LOG_DEBUG("%s has not been written to for %d seconds",
+		      entry->file, RSU_HOST_GROWING_IDLE_TIMEOUT);
+
+	entry->closed = TRUE;
+	prv_host_entry_feed_tails(entry);
+
+on_exit:
+
+	return FALSE;
+}
+
+static void prv_host_entry_arm_idle(rsu_host_entry_t *entry, gint64 delay)
+{
+	/* delay is in microseconds */
+
+	entry->idle_timeout = g_timeout_source_new(delay / 1000 + 1);
+	g_source_set_callback(entry->idle_timeout, prv_host_entry_idle_cb,
+			      entry, NULL);
+	(void) g_source_attach(entry->idle_timeout, entry->service->context);
+	g_source_unref(entry->idle_timeout);
+}
+
+static void prv_host_entry_modified(rsu_host_entry_t *entry)
+{
+	entry->modified_time = g_get_monotonic_time();
+	entry->closed = FALSE;
+
+	if (!entry->idle_timeout)
+		prv_host_entry_arm_idle(
+			entry, RSU_HOST_GROWING_IDLE_TIMEOUT * G_USEC_PER_SEC);
+}
+
+static void prv_host_entries_changed(GPtrArray *entries, guint32 mask)
+{
+	rsu_host_entry_t *entry;
+	unsigned int i;
+
+	for (i = 0; i < entries->len; ++i) {
+		entry = g_ptr_array_index(entries, i);
+
+		/* The file may be opened and written again after it
+		   has been closed */
+
+		if (mask & IN_MODIFY)
+			prv_host_entry_modified(entry);
+
+		if (mask & (IN_CLOSE_WRITE | IN_IGNORED))
+			entry->closed = TRUE;
+
+		if (mask & IN_IGNORED)
+			entry->wd = -1;
+
+		prv_host_entry_feed_tails(entry);
+	}
+}
+
+static gboolean prv_inotify_read_cb(GIOChannel *channel,
+				    GIOCondition condition,
+				    gpointer user_data)
+{
+	rsu_host_service_t *service = user_data;
+	union {
+		struct inotify_event event;
+		gchar data[RSU_HOST_INOTIFY_BUFFER_SIZE];
+	} buffer;
+	struct inotify_event *event;
+	GPtrArray *entries;
+	gssize count;
+	gssize offset;
+
+	count = read(service->inotify_fd, &buffer, sizeof(buffer));
+
+	if (count <= 0)
+		goto on_exit;
+
+	for (offset = 0; offset < count;
+	     offset += sizeof(*event) + event->len) {
+		event = (struct inotify_event *) (buffer.data + offset);
+		entries = g_hash_table_lookup(service->followed,
+					      GINT_TO_POINTER(event->wd));
+		if (!entries)
+			continue;
+
+		/* The kernel drops the watch itself if the file system
+		   goes away */
+
+		if (event->mask & IN_IGNORED) {
+			(void) g_hash_table_steal(service->followed,
+						  GINT_TO_POINTER(event->wd));
+			prv_host_entries_changed(entries, event->mask);
+			g_ptr_array_unref(entries);
+		} else {
+			prv_host_entries_changed(entries, event->mask);
+		}
+	}
+
+on_exit:
+
+	return TRUE;
+}
+
+static gboolean prv_inotify_init(rsu_host_service_t *service)
+{
+	GIOChannel *channel;
+
+	if (service->inotify_fd >= 0)
+		goto on_exit;
+
+	service->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (service->inotify_fd < 0)
+		goto on_exit;
+
+	channel = g_io_channel_unix_new(service->inotify_fd);
+	service->inotify_watch = g_io_create_watch(channel, G_IO_IN);
+	g_source_set_callback(service->inotify_watch,
+			      (GSourceFunc) prv_inotify_read_cb, service,
+			      NULL);
+	(void) g_source_attach(service->inotify_watch, service->context);
+	g_io_channel_unref(channel);
+
+on_exit:
+
+	return service->inotify_fd >= 0;
+}
+
+static void prv_host_entry_follow(rsu_host_entry_t *entry)
+{
+	rsu_host_service_t *service = entry->service;
+	GPtrArray *entries;
+
+	/* A file that cannot be watched is served as far as it has got
+	   when each request is made */
+
+	if (prv_inotify_init(service))
+		entry->wd = inotify_add_watch(service->inotify_fd, entry->file,
+					      IN_MODIFY | IN_CLOSE_WRITE);
+
+	if (entry->wd < 0) {
+		RSU_LOG_WARNING("Unable to follow %s: %s", entry->file,
+				g_strerror(errno));
+		entry->closed = TRUE;
+		goto on_exit;
+	}
+
+	/* Hosting the same file twice yields the same watch */
+
+	entries = g_hash_table_lookup(service->followed,
+				      GINT_TO_POINTER(entry->wd));
+	if (!entries) {
+		entries = g_ptr_array_new();
+		g_hash_table_insert(service->followed,
+				    GINT_TO_POINTER(entry->wd), entries);
+	}
+
+	g_ptr_array_add(entries, entry);
+	prv_host_entry_modified(entry);
+
+on_exit:
+
+	return;
+}
+
+static void prv_host_entry_unfollow(rsu_host_entry_t *entry)
+{
+	rsu_host_service_t *service = entry->service;
+	GPtrArray *entries;
+
+	if (entry->wd >= 0) {
+		entries = g_hash_table_lookup(service->followed,
+					      GINT_TO_POINTER(entry->wd));
+		(void) g_ptr_array_remove_fast(entries, entry);
+
+		if (entries->len == 0) {
+			(void) inotify_rm_watch(service->inotify_fd,
+						entry->wd);
+			(void) g_hash_table_remove(service->followed,
+						   GINT_TO_POINTER(entry->wd));
+		}
+
+		entry->wd = -1;
+	}
+
+	if (entry->idle_timeout) {
+		g_source_destroy(entry->idle_timeout);
+		entry->idle_timeout = NULL;
+	}
+
+	/* Requests still following the file end once they have sent
+	   what has been written so far */
+
+	entry->closed = TRUE;
+	prv_host_entry_feed_tails(entry);
+}
+
+static void prv_host_entry_release(gpointer host_entry)
+{
+	rsu_host_entry_t *entry = host_entry;
+
+	/* A live stream ends as soon as it stops being hosted */
+
+	if (entry->ring) {
+		prv_host_ring_delete(entry->ring);
+		entry->ring = NULL;
+	}
+
+	if (entry->growing)
+		prv_host_entry_unfollow(entry);
+
+	prv_host_entry_unref(entry);
+}
+
+static void prv_host_listener_delete(rsu_host_listener_t *listener)
+{
+	soup_server_quit(listener->soup_server);
+	g_object_unref(listener->soup_server);
+	g_hash_table_unref(listener->urls);
+	g_free(listener);
+}
+
+static gboolean prv_process_commands(gpointer user_data)
+{
+	rsu_host_service_t *service = user_data;
+	rsu_host_command_t *command;
+	rsu_host_entry_t *entry;
+
+	/* Runs in the worker thread */
+
+	while ((command = g_async_queue_try_pop(service->commands))) {
+		switch (command->type) {
+		case RSU_HOST_COMMAND_PROBE:
+			prv_host_job_run(command->job);
+			break;
+		case RSU_HOST_COMMAND_ADD:
+			entry = command->entry;
+			if (entry->live && entry->fd >= 0)
+				entry->ring = prv_host_ring_new(service,
+								entry->fd);
+			else if (entry->growing)
+				prv_host_entry_follow(entry);
+
+			g_hash_table_insert(command->listener->urls,
+					    command->path, entry);
+			break;
+		case RSU_HOST_COMMAND_REMOVE:
+			g_hash_table_remove(command->listener->urls,
+					    command->path);
+			g_free(command->path);
+			break;
+		case RSU_HOST_COMMAND_UPDATE:
+
+			/* Requests already being served keep the old entry,
+			   and its mapping, until they finish */
+
+			entry = g_hash_table_lookup(command->listener->urls,
+						    command->path);
+			if (entry)
+				command->entry->version = entry->version + 1;
+
+			if (command->entry->growing)
+				prv_host_entry_follow(command->entry);
+
+			g_hash_table_replace(command->listener->urls,
+					     command->path, command->entry);
+			break;
+		case RSU_HOST_COMMAND_DELETE:
+			prv_host_listener_delete(command->listener);
+			break;
+		case RSU_HOST_COMMAND_QUIT:
+			g_main_loop_quit(service->loop);
+			break;
+		}
+
+		g_free(command);
+	}
+
+	return FALSE;
+}
+
+static void prv_post_command(rsu_host_service_t *service,
+			     rsu_host_command_type_t type,
+			     rsu_host_listener_t *listener,
+			     gchar *path, rsu_host_entry_t *entry,
+			     rsu_host_job_t *job)
+{
+	rsu_host_command_t *command = g_new0(rsu_host_command_t, 1);
+
+	command->type = type;
+	command->listener = listener;
+	command->path = path;
+	command->entry = entry;
+	command->job = job;
+
+	g_async_queue_push(service->commands, command);
+	g_main_context_invoke(service->context, prv_process_commands,
+			      service);
+}
+
+static void prv_host_server_delete(gpointer host_server)
+{
+	rsu_host_server_t *server = host_server;
+
+	if (server) {
+		prv_post_command(server->service, RSU_HOST_COMMAND_DELETE,
+				 server->listener, NULL, NULL, NULL);
+		g_hash_table_unref(server->files);
+		g_free(server->device_if);
+		g_free(server);
+	}
+}
+
+static void prv_soup_message_finished_cb(SoupMessage *msg, gpointer user_data)
+{
+	rsu_host_entry_t *entry = user_data;
+	rsu_host_service_t *service = entry->service;
+
+	/* The mapping is kept for the next request for the file until
+	   the budget is needed for other files */
+
+	if (--entry->mapped_count == 0) {
+		g_queue_push_head(service->idle_mappings, entry);
+		entry->idle_link = service->idle_mappings->head;
+		prv_trim_mappings(service);
+	}
+
+	prv_host_entry_unref(entry);
+}
+
+static gboolean prv_host_entry_is_stale(rsu_host_entry_t *entry,
+					const struct stat *st)
+{
+	/* A mapping kept from an earlier request is stale if the file
+	   has changed since.  A file may be rewritten within the same
+	   second, so the whole timestamp is compared. */
+
+	return entry->mapped_file &&
+		(entry->mapped_ino != st->st_ino ||
+		 entry->mapped_mtime.tv_sec != st->st_mtim.tv_sec ||
+		 entry->mapped_mtime.tv_nsec != st->st_mtim.tv_nsec ||
+		 (goffset) g_mapped_file_get_length(entry->mapped_file) !=
+		 st->st_size);
+}
+
+static gboolean prv_host_entry_map(rsu_host_entry_t *entry,
+				   const struct stat *st)
+{
+	rsu_host_service_t *service = entry->service;
+	gboolean retval = FALSE;
+
+	/* A stale mapping is only replaced once nothing is reading it */
+
+	if (entry->mapped_count == 0 && prv_host_entry_is_stale(entry, st))
+		prv_host_entry_unmap(entry);
+
+	if (!entry->mapped_file) {
+		if (entry->fd >= 0)
+			entry->mapped_file = g_mapped_file_new_from_fd(
+				entry->fd, FALSE, NULL);
+		else
+			entry->mapped_file = g_mapped_file_new(entry->file,
+							       FALSE, NULL);
+		if (!entry->mapped_file)
+			goto on_error;
+
+		entry->mapped_mtime = st->st_mtim;
+		entry->mapped_ino = st->st_ino;
+		service->mapped_bytes +=
+			g_mapped_file_get_length(entry->mapped_file);
+	}
+
+	if (entry->idle_link) {
+		g_queue_delete_link(service->idle_mappings, entry->idle_link);
+		entry->idle_link = NULL;
+	}
+
+	++entry->mapped_count;
+	++entry->ref_count;
+	prv_trim_mappings(service);
+
+	retval = TRUE;
+
+on_error:
+
+	return retval;
+}
+
+static gboolean prv_host_entry_is_sequential(rsu_host_entry_t *entry,
+					     SoupClientContext *client,
+					     SoupRange *ranges, int length)
+{
+	const char *host = soup_client_context_get_host(client);
+	goffset *next_offset;
+	gboolean sequential;
+
+	/* Renderers play a file through either in a single request or
+	   in a series of ranges, each starting where the last one
+	   ended.  Anything else is seeking, for which reading ahead is
+	   wasted.  Renderers may open a new connection for each range,
+	   so the position is kept per address.  Two renderers playing
+	   the same file then do not look as if they were seeking. */
+
+	if (!entry->next_offsets)
+		entry->next_offsets = g_hash_table_new_full(g_str_hash,
+							    g_str_equal,
+							    g_free, g_free);
+
+	next_offset = g_hash_table_lookup(entry->next_offsets, host);
+
+	sequential = length == 1 && (ranges[0].start == 0 ||
+				     (next_offset &&
+				      ranges[0].start == *next_offset));
+
+	if (!next_offset) {
+		if (g_hash_table_size(entry->next_offsets) >=
+		    RSU_HOST_MAX_CLIENT_OFFSETS)
+			g_hash_table_remove_all(entry->next_offsets);
+
+		next_offset = g_new(goffset, 1);
+		g_hash_table_insert(entry->next_offsets, g_strdup(host),
+				    next_offset);
+	}
+
+	*next_offset = ranges[length - 1].end + 1;
+
+	return sequential;
+}
+
+static void prv_advise_mapping(rsu_host_entry_t *entry, SoupRange *ranges,
+			       int length, gboolean sequential)
+{
+	gchar *data = g_mapped_file_get_contents(entry->mapped_file);
+	goffset total = g_mapped_file_get_length(entry->mapped_file);
+	goffset page = sysconf(_SC_PAGESIZE);
+	goffset start;
+	goffset end;
+	int i;
+
+	if (!data)
+		goto on_exit;
+
+	for (i = 0; i < length; ++i) {
+		start = ranges[i].start & ~(page - 1);
+		end = ranges[i].end + 1;
+
+		if (sequential)
+			end = MIN(end + RSU_HOST_READ_AHEAD, total);
+
+		(void) madvise(data + start, end - start,
+			       sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+		(void) madvise(data + start, end - start, MADV_WILLNEED);
+	}
+
+on_exit:
+
+	return;
+}
+
+static void prv_set_mapped_response(SoupMessage *msg, rsu_host_entry_t *entry,
+				    SoupRange *ranges, int length,
+				    gboolean partial)
+{
+	const gchar *data = g_mapped_file_get_contents(entry->mapped_file);
+	goffset total = g_mapped_file_get_length(entry->mapped_file);
+	SoupMultipart *multipart;
+	SoupMessageHeaders *part_headers;
+	SoupBuffer *part_body;
+	int i;
+
+	/* The response bodies point straight into the mapped file, which
+	   is kept alive until the message has finished */
+
+	if (!partial) {
+		soup_message_set_response(msg, entry->mime_type,
+					  SOUP_MEMORY_STATIC, data, total);
+		goto on_exit;
+	}
+
+	if (length == 1) {
+		soup_message_headers_set_content_range(msg->response_headers,
+						       ranges[0].start,
+						       ranges[0].end, total);
+		soup_message_set_response(msg, entry->mime_type,
+					  SOUP_MEMORY_STATIC,
+					  data + ranges[0].start,
+					  ranges[0].end - ranges[0].start + 1);
+		goto on_exit;
+	}
+
+	multipart = soup_multipart_new("multipart/byteranges");
+
+	for (i = 0; i < length; ++i) {
+		part_headers = soup_message_headers_new(
+			SOUP_MESSAGE_HEADERS_MULTIPART);
+		soup_message_headers_set_content_type(part_headers,
+						      entry->mime_type, NULL);
+		soup_message_headers_set_content_range(part_headers,
+						       ranges[i].start,
+						       ranges[i].end, total);
+		part_body = soup_buffer_new(
+			SOUP_MEMORY_STATIC, data + ranges[i].start,
+			ranges[i].end - ranges[i].start + 1);
+		soup_multipart_append_part(multipart, part_headers, part_body);
+		soup_buffer_free(part_body);
+		soup_message_headers_free(part_headers);
+	}
+
+	soup_multipart_to_message(multipart, msg->response_headers,
+				  msg->response_body);
+	soup_multipart_free(multipart);
+
+on_exit:
+
+	return;
+}
+
+static void prv_host_stream_delete(rsu_host_stream_t *stream)
+{
+	unsigned int i;
+
+	for (i = 0; i < stream->segments->len; ++i)
+		g_free(g_array_index(stream->segments, rsu_host_segment_t,
+				     i).header);
+
+	g_array_unref(stream->segments);
+	(void) close(stream->fd);
+	g_free(stream);
+}
+
+static goffset prv_host_stream_add(rsu_host_stream_t *stream, gchar *header,
+				   goffset offset, goffset length)
+{
+	rsu_host_segment_t segment;
+
+	segment.header = header;
+	segment.offset = offset;
+	segment.length = length;
+	g_array_append_val(stream->segments, segment);
+
+	return (header ? strlen(header) : 0) + length;
+}
+
+static gboolean prv_host_stream_next_chunk(rsu_host_stream_t *stream,
+					   SoupMessage *msg)
+{
+	rsu_host_segment_t *segment;
+	gchar *buffer;
+	gssize size;
+	gboolean retval = TRUE;
+
+	/* Only one chunk is handed to libsoup at a time, so a connection
+	   never holds more than RSU_HOST_STREAM_CHUNK_SIZE bytes of the
+	   file in memory, however large the file is */
+
+	while (stream->current < stream->segments->len) {
+		segment = &g_array_index(stream->segments, rsu_host_segment_t,
+					 stream->current);
+
+		if (segment->header) {
+			soup_message_body_append(msg->response_body,
+						 SOUP_MEMORY_TAKE,
+						 segment->header,
+						 strlen(segment->header));
+			segment->header = NULL;
+			goto on_exit;
+		}
+
+		if (segment->length > 0) {
+			size = MIN(segment->length, RSU_HOST_STREAM_CHUNK_SIZE);
+			buffer = g_malloc(size);
+			size = pread(stream->fd, buffer, size, segment->offset);
+
+			if (size <= 0) {
+				g_free(buffer);
+				retval = FALSE;
+				goto on_exit;
+			}
+
+			segment->offset += size;
+			segment->length -= size;
+			soup_message_body_append(msg->response_body,
+						 SOUP_MEMORY_TAKE, buffer,
+						 size);
+			goto on_exit;
+		}
+
+		++stream->current;
+	}
+
+	soup_message_body_complete(msg->response_body);
+
+on_exit:
+
+	return retval;
+}
+
+static void prv_host_stream_abort(rsu_host_stream_t *stream)
+{
+	RSU_LOG_WARNING("Unable to read hosted file.  Closing connection");
+
+	/* The headers promised more data than can be delivered so the
+	   only thing left to do is to drop the connection */
+
+	soup_socket_disconnect(soup_client_context_get_socket(stream->client));
+}
+
+static void prv_host_stream_wrote_chunk_cb(SoupMessage *msg,
+					   gpointer user_data)
+{
+	rsu_host_stream_t *stream = user_data;
+
+	if (!prv_host_stream_next_chunk(stream, msg))
+		prv_host_stream_abort(stream);
+}
+
+static void prv_host_stream_finished_cb(SoupMessage *msg, gpointer user_data)
+{
+	prv_host_stream_delete(user_data);
+}
+
+static void prv_set_stream_response(SoupMessage *msg,
+				    SoupClientContext *client,
+				    rsu_host_entry_t *entry, SoupRange *ranges,
+				    int length, gboolean partial,
+				    goffset total, gboolean sequential)
+{
+	SoupMessageHeaders *hdrs = msg->response_headers;
+	rsu_host_stream_t *stream;
+	gchar *boundary;
+	gchar *header;
+	gchar *content_type;
+	goffset content_length = 0;
+	int fd;
+	int i;
+
+	if (entry->fd >= 0)
+		fd = dup(entry->fd);
+	else
+		fd = open(entry->file, O_RDONLY);
+
+	if (fd < 0) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+		goto on_error;
+	}
+
+	if (sequential) {
+		(void) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		(void) posix_fadvise(fd, ranges[0].start,
+				     RSU_HOST_READ_AHEAD, POSIX_FADV_WILLNEED);
+	} else {
+		(void) posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+	}
+
+	stream = g_new0(rsu_host_stream_t, 1);
+	stream->fd = fd;
+	stream->client = client;
+	stream->segments = g_array_new(FALSE, FALSE,
+				       sizeof(rsu_host_segment_t));
+
+	if (!partial) {
+		content_length = prv_host_stream_add(stream, NULL, 0, total);
+		soup_message_headers_set_content_type(hdrs, entry->mime_type,
+						      NULL);
+	} else if (length == 1) {
+		content_length = prv_host_stream_add(
+			stream, NULL, ranges[0].start,
+			ranges[0].end - ranges[0].start + 1);
+		soup_message_headers_set_content_range(hdrs, ranges[0].start,
+						       ranges[0].end, total);
+		soup_message_headers_set_content_type(hdrs, entry->mime_type,
+						      NULL);
+	} else {
+		boundary = g_strdup_printf("%08x%08x", g_random_int(),
+					   g_random_int());
+
+		for (i = 0; i < length; ++i) {
+			header = g_strdup_printf(
+				"%s--%s\r\nContent-Type: %s\r\n"
+				"Content-Range: bytes %"G_GOFFSET_FORMAT"-%"
+				G_GOFFSET_FORMAT"/%"G_GOFFSET_FORMAT"\r\n\r\n",
+				i ? "\r\n" : "", boundary, entry->mime_type,
+				ranges[i].start, ranges[i].end, total);
+			content_length += prv_host_stream_add(
+				stream, header, ranges[i].start,
+				ranges[i].end - ranges[i].start + 1);
+		}
+
+		header = g_strdup_printf("\r\n--%s--\r\n", boundary);
+		content_length += prv_host_stream_add(stream, header, 0, 0);
+
+		content_type = g_strdup_printf(
+			"multipart/byteranges; boundary=%s", boundary);
+		soup_message_headers_replace(hdrs, "Content-Type",
+					     content_type);
+		g_free(content_type);
+		g_free(boundary);
+	}
+
+	soup_message_headers_set_content_length(hdrs, content_length);
+	soup_message_body_set_accumulate(msg->response_body, FALSE);
+
+	g_signal_connect(msg, "wrote-chunk",
+			 G_CALLBACK(prv_host_stream_wrote_chunk_cb), stream);
+	g_signal_connect(msg, "finished",
+			 G_CALLBACK(prv_host_stream_finished_cb), stream);
+
+	if (!prv_host_stream_next_chunk(stream, msg))
+		prv_host_stream_abort(stream);
+
+on_error:
+
+	return;
+}
+
+static void prv_set_head_response(SoupMessage *msg, rsu_host_entry_t *entry,
+				  SoupRange *ranges, int length,
+				  gboolean partial, goffset total)
+{
+	SoupMessageHeaders *hdrs = msg->response_headers;
+
+	/* libsoup never sends a body in response to HEAD but it keeps
+	   the Content-Length set here.  The boundary and length of a
+	   multipart/byteranges body are only known once it is built, so
+	   a HEAD for several ranges is answered as if no range had been
+	   asked for, which a server may always do. */
+
+	if (partial && length > 1) {
+		soup_message_set_status(msg, SOUP_STATUS_OK);
+		partial = FALSE;
+	}
+
+	soup_message_headers_set_content_type(hdrs, entry->mime_type, NULL);
+
+	if (partial) {
+		soup_message_headers_set_content_range(hdrs, ranges[0].start,
+						       ranges[0].end, total);
+		soup_message_headers_set_content_length(
+			hdrs, ranges[0].end - ranges[0].start + 1);
+	} else {
+		soup_message_headers_set_content_length(hdrs, total);
+	}
+}
+
+static gboolean prv_etag_matches(const gchar *header, const gchar *etag)
+{
+	GSList *tags;
+	GSList *tag;
+	const gchar *value;
+	gboolean retval = FALSE;
+
+	tags = soup_header_parse_list(header);
+
+	for (tag = tags; tag; tag = tag->next) {
+		value = tag->data;
+
+		/* Weak comparison is enough for a GET */
+
+		if (g_str_has_prefix(value, "W/"))
+			value += 2;
+
+		if (!strcmp(value, "*") || !strcmp(value, etag)) {
+			retval = TRUE;
+			break;
+		}
+	}
+
+	soup_header_free_list(tags);
+
+	return retval;
+}
+
+static gboolean prv_is_not_modified(SoupMessage *msg,
+				    rsu_host_entry_t *entry,
+				    const struct stat *st)
+{
+	SoupMessageHeaders *req_hdrs = msg->request_headers;
+	const gchar *header;
+	gchar *etag;
+	gchar *last_modified;
+	SoupDate *date;
+	gboolean retval = FALSE;
+
+	/* The validators only need a stat of the file, so renderers that
+	   fetch the same file again and again only cost a few headers
+	   while it stays unchanged */
+
+	/* The version changes whenever the file is updated, even if the
+	   new content happens to have the same size and timestamp.  The
+	   nanoseconds of the timestamp tell apart files rewritten in
+	   place within the same second. */
+
+	etag = g_strdup_printf("\"%"G_GINT64_MODIFIER"x-%"
+			       G_GINT64_MODIFIER"x-%"
+			       G_GINT64_MODIFIER"x.%lx-%x\"",
+			       (gint64) st->st_ino, (gint64) st->st_size,
+			       (gint64) st->st_mtime,
+			       (unsigned long) st->st_mtim.tv_nsec,
+			       entry->version);
+	date = soup_date_new_from_time_t(st->st_mtime);
+	last_modified = soup_date_to_string(date, SOUP_DATE_HTTP);
+	soup_date_free(date);
+
+	soup_message_headers_replace(msg->response_headers, "ETag", etag);
+	soup_message_headers_replace(msg->response_headers, "Last-Modified",
+				     last_modified);
+
+	/* If-None-Match takes precedence over If-Modified-Since when a
+	   request carries both */
+
+	header = soup_message_headers_get_list(req_hdrs, "If-None-Match");
+
+	if (header) {
+		retval = prv_etag_matches(header, etag);
+		goto on_exit;
+	}
+
+	/* Last-Modified has a resolution of a second, and a file can be
+	   updated several times a second.  Once a file has been updated,
+	   only its ETag can show whether a renderer has the latest
+	   contents. */
+
+	if (entry->version > 0)
+		goto on_exit;
+
+	header = soup_message_headers_get_one(req_hdrs, "If-Modified-Since");
+
+	if (header) {
+		date = soup_date_new_from_string(header);
+
+		if (date) {
+			retval = st->st_mtime <= soup_date_to_time_t(date);
+			soup_date_free(date);
+		}
+	}
+
+on_exit:
+
+	g_free(last_modified);
+	g_free(etag);
+
+	return retval;
+}
+
+static void prv_set_response(SoupMessage *msg, SoupClientContext *client,
+			     rsu_host_entry_t *entry, goffset total,
+			     rsu_host_body_t body)
+{
+	SoupMessageHeaders *req_hdrs = msg->request_headers;
+	SoupRange whole = { 0, total - 1 };
+	SoupRange *ranges = &whole;
+	int length = 1;
+	gboolean partial = FALSE;
+	gboolean sequential;
+	gchar *content_range;
+
+	soup_message_headers_replace(msg->response_headers, "Accept-Ranges",
+				     "bytes");
+
+	if (soup_message_headers_get_one(req_hdrs, "Range")) {
+		if (!soup_message_headers_get_ranges(req_hdrs, total, &ranges,
+						     &length)) {
+			soup_message_set_status(
+				msg,
+				SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE);
+			content_range = g_strdup_printf(
+				"bytes */%"G_GOFFSET_FORMAT, total);
+			soup_message_headers_replace(msg->response_headers,
+						     "Content-Range",
+						     content_range);
+			g_free(content_range);
+			goto on_exit;
+		}
+
+		partial = TRUE;
+	}
+
+	soup_message_set_status(msg, partial ? SOUP_STATUS_PARTIAL_CONTENT :
+				SOUP_STATUS_OK);
+
+	switch (body) {
+	case RSU_HOST_BODY_NONE:
+		prv_set_head_response(msg, entry, ranges, length, partial,
+				      total);
+		break;
+	case RSU_HOST_BODY_MAPPED:
+		sequential = prv_host_entry_is_sequential(entry, client,
+							  ranges, length);
+		prv_advise_mapping(entry, ranges, length, sequential);
+		prv_set_mapped_response(msg, entry, ranges, length, partial);
+		break;
+	case RSU_HOST_BODY_STREAMED:
+		sequential = prv_host_entry_is_sequential(entry, client,
+							  ranges, length);
+		prv_set_stream_response(msg, client, entry, ranges, length,
+					partial, total, sequential);
+		break;
+	}
+
+	if (partial)
+		soup_message_headers_free_ranges(req_hdrs, ranges);
+
+on_exit:
+
+	return;
+}
+
+static void prv_host_reader_wrote_chunk_cb(SoupMessage *msg,
+					   gpointer user_data)
 {
-	rsu_host_file_t *hf = host_file;
-	unsigned int i;
+	rsu_host_reader_t *reader = user_data;
 
-	if (hf) {
-		g_free(hf->path);
-		for (i = 0; i < hf->mapped_count; ++i)
-			g_mapped_file_unref(hf->mapped_file);
+	reader->writing = FALSE;
+	prv_host_reader_feed(reader);
 
-		g_ptr_array_unref(hf->clients);
+	if (!reader->writing && !reader->complete)
+		soup_server_pause_message(reader->server, msg);
 
-		g_free(hf->mime_type);
-		g_free(hf);
-	}
+	if (reader->ring)
+		prv_host_ring_watch(reader->ring);
 }
 
-static rsu_host_file_t *prv_host_file_new(const gchar *file, unsigned int id,
-					  GError **error)
+static void prv_host_reader_finished_cb(SoupMessage *msg,
+					gpointer user_data)
 {
-	rsu_host_file_t *hf = NULL;
-	gchar *extension;
-	gchar *content_type = NULL;
+	rsu_host_reader_t *reader = user_data;
 
-	if (!g_file_test(file, G_FILE_TEST_IS_REGULAR | G_FILE_TEST_EXISTS)) {
-		*error = g_error_new(RSU_ERROR, RSU_ERROR_OBJECT_NOT_FOUND,
-				     "File %s does not exist or is not"
-				     " a regular file", file);
-		goto on_error;
+	if (reader->ring) {
+		(void) g_ptr_array_remove_fast(reader->ring->readers, reader);
+		prv_host_ring_watch(reader->ring);
 	}
 
-	hf = g_new0(rsu_host_file_t, 1);
-	hf->id = id;
-	hf->clients = g_ptr_array_new_with_free_func(g_free);
+	prv_host_entry_unref(reader->entry);
+	g_free(reader);
+}
 
-	content_type = g_content_type_guess(file, NULL, 0, NULL);
+static void prv_set_unbounded_response(SoupMessage *msg,
+				       rsu_host_entry_t *entry)
+{
+	SoupMessageHeaders *hdrs = msg->response_headers;
 
-	if (!content_type) {
-		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_MIME,
-				     "Unable to determine Content Type for"
-				     " %s", file);
-		goto on_error;
-	}
+	/* The length of the content is not known in advance, and
+	   HTTP/1.0 clients do not understand chunked encoding */
+
+	soup_message_set_status(msg, SOUP_STATUS_OK);
+	soup_message_headers_set_content_type(hdrs, entry->mime_type, NULL);
+	soup_message_headers_set_encoding(
+		hdrs, soup_message_get_http_version(msg) == SOUP_HTTP_1_0 ?
+		SOUP_ENCODING_EOF : SOUP_ENCODING_CHUNKED);
 
-	hf->mime_type =  g_content_type_get_mime_type(content_type);
+	if (msg->method != SOUP_METHOD_HEAD)
+		soup_message_body_set_accumulate(msg->response_body, FALSE);
+}
 
-	if (!hf->mime_type) {
-		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_MIME,
-				     "Unable to determine MIME Type for"
-				     " %s", file);
-		goto on_error;
+static void prv_set_live_response(SoupServer *server, SoupMessage *msg,
+				  SoupClientContext *client,
+				  rsu_host_entry_t *entry)
+{
+	rsu_host_reader_t *reader;
+
+	if (!entry->ring) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+		goto on_exit;
 	}
 
-	g_free(content_type);
+	prv_set_unbounded_response(msg, entry);
 
-	extension = strrchr(file, '.');
-	hf->path = g_strdup_printf(HOST_SERVICE_ROOT"/%d%s",
-				   hf->id, extension ? extension : "");
-	return hf;
+	if (msg->method == SOUP_METHOD_HEAD)
+		goto on_exit;
 
-on_error:
+	/* Renderers join the stream where it is now */
 
-	g_free(content_type);
-	prv_host_file_delete(hf);
+	reader = g_new0(rsu_host_reader_t, 1);
+	reader->ring = entry->ring;
+	reader->entry = entry;
+	reader->server = server;
+	reader->msg = msg;
+	reader->client = client;
+	reader->position = entry->ring->head;
+	++entry->ref_count;
+	g_ptr_array_add(entry->ring->readers, reader);
 
-	return NULL;
-}
+	g_signal_connect(msg, "wrote-chunk",
+			 G_CALLBACK(prv_host_reader_wrote_chunk_cb), reader);
+	g_signal_connect(msg, "finished",
+			 G_CALLBACK(prv_host_reader_finished_cb), reader);
 
-static void prv_host_server_delete(gpointer host_server)
-{
-	rsu_host_server_t *server = host_server;
+	prv_host_reader_feed(reader);
 
-	if (server) {
-		soup_server_quit(server->soup_server);
-		g_object_unref(server->soup_server);
-		g_hash_table_unref(server->files);
-		g_free(server);
-	}
+	if (!reader->writing && !reader->complete)
+		soup_server_pause_message(server, msg);
+
+on_exit:
+
+	return;
 }
 
-static rsu_host_file_t *prv_host_server_find_file(rsu_host_server_t *hs,
-						  const gchar *url,
-						  const gchar **file_name)
+static void prv_host_tail_wrote_chunk_cb(SoupMessage *msg,
+					 gpointer user_data)
 {
-	rsu_host_file_t *retval = NULL;
-	GHashTableIter iter;
-	gpointer key;
-	gpointer value;
+	rsu_host_tail_t *tail = user_data;
 
-	g_hash_table_iter_init(&iter, hs->files);
+	tail->writing = FALSE;
+	prv_host_tail_feed(tail);
 
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		if (!strcmp(((rsu_host_file_t *) value)->path, url)) {
-			retval = value;
-			*file_name = key;
-			break;
-		}
-	}
+	if (!tail->writing && !tail->complete)
+		soup_server_pause_message(tail->server, msg);
+}
 
-	return retval;
+static void prv_host_tail_finished_cb(SoupMessage *msg, gpointer user_data)
+{
+	rsu_host_tail_t *tail = user_data;
+
+	(void) g_ptr_array_remove_fast(tail->entry->tails, tail);
+	(void) close(tail->fd);
+	prv_host_entry_unref(tail->entry);
+	g_free(tail);
 }
 
-static void prv_soup_message_finished_cb(SoupMessage *msg, gpointer user_data)
+static void prv_set_growing_response(SoupServer *server, SoupMessage *msg,
+				     rsu_host_entry_t *entry)
 {
-	rsu_host_file_t *hf = user_data;
+	rsu_host_tail_t *tail;
+	int fd;
+
+	/* Each request has its own descriptor so that it keeps reading
+	   the same file even if another is renamed over it */
+
+	fd = open(entry->file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+		goto on_exit;
+	}
 
-	if (hf->mapped_count > 0) {
-		g_mapped_file_unref(hf->mapped_file);
-		--hf->mapped_count;
+	prv_set_unbounded_response(msg, entry);
 
-		if (hf->mapped_count == 0)
-			hf->mapped_file = NULL;
+	if (msg->method == SOUP_METHOD_HEAD) {
+		(void) close(fd);
+		goto on_exit;
 	}
+
+	tail = g_new0(rsu_host_tail_t, 1);
+	tail->entry = entry;
+	tail->server = server;
+	tail->msg = msg;
+	tail->fd = fd;
+	++entry->ref_count;
+	g_ptr_array_add(entry->tails, tail);
+
+	g_signal_connect(msg, "wrote-chunk",
+			 G_CALLBACK(prv_host_tail_wrote_chunk_cb), tail);
+	g_signal_connect(msg, "finished",
+			 G_CALLBACK(prv_host_tail_finished_cb), tail);
+
+	prv_host_tail_feed(tail);
+
+	if (!tail->writing && !tail->complete)
+		soup_server_pause_message(server, msg);
+
+on_exit:
+
+	return;
 }
 
 static void prv_soup_server_cb(SoupServer *server, SoupMessage *msg,
 			       const char *path, GHashTable *query,
 			       SoupClientContext *client, gpointer user_data)
 {
-	rsu_host_file_t *hf;
-	rsu_host_server_t *hs = user_data;
-	const gchar *file_name;
-	SoupMessageHeaders *hdrs;
+	rsu_host_entry_t *entry;
+	rsu_host_listener_t *listener = user_data;
+	struct stat st;
+	int err;
 
-	if (msg->method != SOUP_METHOD_GET) {
+	if (msg->method != SOUP_METHOD_GET &&
+	    msg->method != SOUP_METHOD_HEAD) {
 		soup_message_set_status(msg, SOUP_STATUS_NOT_IMPLEMENTED);
 		goto on_error;
 	}
 
-	hf = prv_host_server_find_file(hs, path, &file_name);
+	entry = g_hash_table_lookup(listener->urls, path);
 
-	if (!hf) {
+	if (!entry) {
 		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
 		goto on_error;
 	}
 
-	if (hf->mapped_file) {
-		g_mapped_file_ref(hf->mapped_file);
-		++hf->mapped_count;
-	} else {
-		hf->mapped_file = g_mapped_file_new(file_name, FALSE, NULL);
+	soup_message_headers_replace(msg->response_headers,
+				     "transferMode.dlna.org",
+				     entry->transfer_mode);
+	soup_message_headers_replace(msg->response_headers,
+				     "contentFeatures.dlna.org",
+				     entry->content_features);
 
-		if (!hf->mapped_file) {
-			soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
-			goto on_error;
-		}
+	if (entry->live) {
+		prv_set_live_response(server, msg, client, entry);
+		goto on_error;
+	}
 
-		hf->mapped_count = 1;
+	if (entry->growing) {
+		prv_set_growing_response(server, msg, entry);
+		goto on_error;
 	}
 
-	g_signal_connect(msg, "finished",
-			 G_CALLBACK(prv_soup_message_finished_cb), hf);
+	if (entry->fd >= 0)
+		err = fstat(entry->fd, &st);
+	else
+		err = stat(entry->file, &st);
+
+	if (err || !S_ISREG(st.st_mode)) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+		goto on_error;
+	}
 
-	g_object_get(msg, "response-headers", &hdrs, NULL);
+	if (prv_is_not_modified(msg, entry, &st)) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_MODIFIED);
+		goto on_error;
+	}
 
-	/* TODO: Need to add the relevant DLNA headers */
+	/* Renderers often probe with HEAD before every GET, so it is
+	   answered without reading the file */
 
-/*	soup_message_headers_append(hdrs, "contentFeatures.dlna.org",
-			"DLNA.ORG_PN=PNG_LRG;DLNA.ORG_OP=01;"\
-			"DLNA.ORG_FLAGS=00f00000000000000000000000000000");
-	soup_message_headers_append(hdrs, "Connection", "close");
-*/
-	soup_message_set_status(msg, SOUP_STATUS_OK);
-	soup_message_set_response(msg, hf->mime_type, SOUP_MEMORY_STATIC,
-				  g_mapped_file_get_contents(hf->mapped_file),
-				  g_mapped_file_get_length(hf->mapped_file));
+	if (msg->method == SOUP_METHOD_HEAD) {
+		prv_set_response(msg, client, entry, st.st_size,
+				 RSU_HOST_BODY_NONE);
+		goto on_error;
+	}
+
+	/* The validators describe the file as it is now.  While earlier
+	   requests are still reading a mapping of its old content the
+	   new content is streamed from a fresh descriptor instead, so
+	   that the body matches them. */
+
+	if (st.st_size > RSU_HOST_STREAM_THRESHOLD ||
+	    (entry->mapped_count > 0 &&
+	     prv_host_entry_is_stale(entry, &st))) {
+		prv_set_response(msg, client, entry, st.st_size,
+				 RSU_HOST_BODY_STREAMED);
+		goto on_error;
+	}
+
+	if (!prv_host_entry_map(entry, &st)) {
+		soup_message_set_status(msg, SOUP_STATUS_NOT_FOUND);
+		goto on_error;
+	}
+
+	g_signal_connect(msg, "finished",
+			 G_CALLBACK(prv_soup_message_finished_cb), entry);
+
+	prv_set_response(msg, client, entry,
+			 g_mapped_file_get_length(entry->mapped_file),
+			 RSU_HOST_BODY_MAPPED);
 
 on_error:
 
 	return;
 }
 
-static rsu_host_server_t *prv_host_server_new(const gchar *device_if,
-					      GError **error)
+static rsu_host_listener_t *prv_host_listener_new(
+	rsu_host_service_t *service, const gchar *device_if, GError **error)
 {
-	rsu_host_server_t *server = NULL;
+	rsu_host_listener_t *listener = NULL;
+	SoupServer *soup_server;
 	SoupAddress *addr;
 
+	/* Runs in the worker thread */
+
 	addr = soup_address_new(device_if, SOUP_ADDRESS_ANY_PORT);
 
 	if (soup_address_resolve_sync(addr, NULL) != SOUP_STATUS_OK) {
@@ -239,117 +1882,474 @@ static rsu_host_server_t *prv_host_server_new(const gchar *device_if,
 		goto on_error;
 	}
 
-	server = g_new(rsu_host_server_t, 1);
-	server->files = g_hash_table_new_full(g_str_hash, g_str_equal,
-					      g_free, prv_host_file_delete);
+	soup_server = soup_server_new(SOUP_SERVER_INTERFACE, addr,
+				      SOUP_SERVER_ASYNC_CONTEXT,
+				      service->context, NULL);
+	if (!soup_server) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_HOST_FAILED,
+				     "Unable to create host server on %s",
+				     device_if);
+		goto on_error;
+	}
 
-	server->soup_server = soup_server_new(SOUP_SERVER_INTERFACE, addr,
-					      NULL);
-	soup_server_add_handler(server->soup_server, HOST_SERVICE_ROOT,
-				prv_soup_server_cb, server, NULL);
-	soup_server_run_async(server->soup_server);
-	server->counter = 0;
+	listener = g_new(rsu_host_listener_t, 1);
+	listener->soup_server = soup_server;
+
+	/* Indexes the files by URL path for the HTTP handler */
+
+	listener->urls = g_hash_table_new_full(g_str_hash, g_str_equal,
+					       g_free, prv_host_entry_release);
+
+	soup_server_add_handler(soup_server, HOST_SERVICE_ROOT,
+				prv_soup_server_cb, listener, NULL);
+	soup_server_run_async(soup_server);
 
 on_error:
 
 	g_object_unref(addr);
 
+	return listener;
+}
+
+static const gchar *prv_server_address(rsu_host_service_t *service,
+				       const gchar *device_if)
+{
+	/* Renderers still reach the shared server through the address
+	   of their own interface, which is what goes into their URLs */
+
+	return service->shared_listener ? RSU_HOST_ANY_INTERFACE : device_if;
+}
+
+static rsu_host_server_t *prv_host_server_new(rsu_host_service_t *service,
+					      const gchar *device_if,
+					      rsu_host_listener_t *listener,
+					      guint port)
+{
+	rsu_host_server_t *server;
+
+	server = g_new(rsu_host_server_t, 1);
+	server->service = service;
+	server->device_if = g_strdup(device_if);
+	server->files = g_hash_table_new_full(g_str_hash, g_str_equal,
+					      g_free, prv_host_file_delete);
+	server->listener = listener;
+	server->port = port;
+	server->counter = 0;
+
 	return server;
 }
 
-void rsu_host_service_new(rsu_host_service_t **host_service)
+static gpointer prv_host_thread(gpointer user_data)
+{
+	rsu_host_service_t *hs = user_data;
+
+	g_main_context_push_thread_default(hs->context);
+	g_main_loop_run(hs->loop);
+	g_main_context_pop_thread_default(hs->context);
+
+	return NULL;
+}
+
+void rsu_host_service_new(rsu_settings_context_t *settings,
+			  rsu_host_service_t **host_service)
 {
 	rsu_host_service_t *hs;
 
 	hs = g_new(rsu_host_service_t, 1);
 	hs->servers = g_hash_table_new_full(g_str_hash, g_str_equal,
-					    g_free, prv_host_server_delete);
+					    NULL, prv_host_server_delete);
+	hs->clients = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) g_hash_table_unref);
+	hs->jobs = g_ptr_array_new();
+	hs->shared_listener = rsu_settings_is_shared_listener(settings);
+	hs->drop_slow_readers = rsu_settings_is_drop_slow_readers(settings);
+	hs->context = g_main_context_new();
+	hs->loop = g_main_loop_new(hs->context, FALSE);
+	hs->commands = g_async_queue_new();
+	hs->mime_cache = rsu_mime_cache_new();
+	hs->idle_mappings = g_queue_new();
+	hs->mapped_bytes = 0;
+	hs->mapping_budget = (goffset) rsu_settings_get_mapping_budget(
+		settings) * 1024 * 1024;
+	hs->inotify_fd = -1;
+	hs->inotify_watch = NULL;
+	hs->followed = g_hash_table_new_full(
+		g_direct_hash, g_direct_equal, NULL,
+		(GDestroyNotify) g_ptr_array_unref);
+	hs->thread = g_thread_new("host-service", prv_host_thread, hs);
 
 	*host_service = hs;
 }
 
-static gchar *prv_add_new_file(rsu_host_server_t *server, const gchar *client,
-			       const gchar *device_if, const gchar *file,
-			       GError **error)
+static void prv_host_job_free(rsu_host_job_t *job)
 {
-	unsigned int i;
-	rsu_host_file_t *hf;
-	gchar *str;
+	g_free(job->device_if);
+	g_free(job->client);
+	g_free(job->file);
+	g_free(job->mime_type);
+	prv_host_file_delete(job->hf);
 
-	hf = g_hash_table_lookup(server->files, file);
+	if (job->fd >= 0)
+		(void) close(job->fd);
 
-	if (!hf) {
-		hf = prv_host_file_new(file, server->counter++, error);
+	if (job->error)
+		g_error_free(job->error);
 
-		if (!hf)
-			goto on_error;
+	g_free(job);
+}
 
-		g_ptr_array_add(hf->clients, g_strdup(client));
-		g_hash_table_insert(server->files, g_strdup(file), hf);
-	} else {
-		for (i = 0; i < hf->clients->len; ++i)
-			if (!strcmp(g_ptr_array_index(hf->clients, i), client))
-				break;
+static void prv_add_client(rsu_host_service_t *service, rsu_host_file_t *hf,
+			   const gchar *client)
+{
+	GHashTable *files;
+
+	if (g_hash_table_contains(hf->clients, client))
+		goto on_exit;
+
+	g_hash_table_add(hf->clients, g_strdup(client));
+
+	files = g_hash_table_lookup(service->clients, client);
+
+	if (!files) {
+		files = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_hash_table_insert(service->clients, g_strdup(client), files);
+	}
+
+	g_hash_table_add(files, hf);
+
+on_exit:
+
+	return;
+}
+
+static gchar *prv_add_new_file(rsu_host_server_t *server,
+			       rsu_host_job_t *job)
+{
+	rsu_host_file_t *hf = NULL;
+	gchar *extension = NULL;
+	gchar *url = NULL;
+
+	/* The file may have been hosted by another request while this
+	   one was being probed.  Content passed by descriptor is always
+	   hosted afresh. */
+
+	if (job->file)
+		hf = g_hash_table_lookup(server->files, job->file);
+
+	/* A file has a single URL, which either follows it as it grows
+	   or serves it as it stands */
 
-		if (i == hf->clients->len)
-			g_ptr_array_add(hf->clients, g_strdup(client));
+	if (hf && hf->growing != job->growing) {
+		job->error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+					 "File %s is already hosted %s",
+					 job->file, hf->growing ?
+					 "as a growing file" :
+					 "as a complete file");
+		goto on_error;
+	}
+
+	if (!hf) {
+		hf = job->hf;
+		job->hf = NULL;
+
+		hf->id = server->counter++;
+		hf->server = server;
+		if (hf->file)
+			extension = strrchr(hf->file, '.');
+		hf->path = g_strdup_printf(HOST_SERVICE_ROOT"/%d%s",
+					   hf->id, extension ? extension : "");
+
+		/* Such content is known by its URL path instead, which
+		   is what the client passes to RemoveFile */
+
+		if (!hf->file)
+			hf->file = g_strdup(hf->path);
+
+		g_hash_table_insert(server->files, g_strdup(hf->file), hf);
+		prv_post_command(server->service, RSU_HOST_COMMAND_ADD,
+				 server->listener, g_strdup(hf->path),
+				 prv_host_entry_new(server->service, hf),
+				 NULL);
 	}
 
-	str = g_strdup_printf("http://%s:%d%s", device_if,
-			      soup_server_get_port(server->soup_server),
+	prv_add_client(server->service, hf, job->client);
+
+	url = g_strdup_printf("http://%s:%u%s", job->device_if, server->port,
 			      hf->path);
 
-	return str;
+on_error:
+
+	return url;
+}
+
+static gchar *prv_update_file(rsu_host_service_t *service,
+			      rsu_host_job_t *job)
+{
+	rsu_host_server_t *server;
+	rsu_host_file_t *hf = NULL;
+	gchar *url = NULL;
+
+	server = g_hash_table_lookup(service->servers,
+				     prv_server_address(service,
+							job->device_if));
+	if (server)
+		hf = g_hash_table_lookup(server->files, job->file);
+
+	if (!hf || !g_hash_table_contains(hf->clients, job->client)) {
+		job->error = g_error_new(RSU_ERROR, RSU_ERROR_OBJECT_NOT_FOUND,
+					 "File not hosted for specified "
+					 "device");
+		goto on_error;
+	}
+
+	/* The id and path stay the same so the URL does not change */
+
+	g_free(hf->mime_type);
+	hf->mime_type = job->hf->mime_type;
+	job->hf->mime_type = NULL;
+
+	g_free(hf->content_features);
+	hf->content_features = job->hf->content_features;
+	job->hf->content_features = NULL;
+
+	hf->transfer_mode = job->hf->transfer_mode;
+
+	prv_post_command(service, RSU_HOST_COMMAND_UPDATE, server->listener,
+			 g_strdup(hf->path), prv_host_entry_new(service, hf),
+			 NULL);
+
+	url = g_strdup_printf("http://%s:%u%s", job->device_if, server->port,
+			      hf->path);
 
 on_error:
 
-	return NULL;
+	return url;
 }
 
-gchar *rsu_host_service_add(rsu_host_service_t *host_service,
-			    const gchar *device_if, const gchar *client,
-			    const gchar *file, GError **error)
+static gboolean prv_host_job_done_cb(gpointer user_data)
 {
+	rsu_host_job_t *job = user_data;
+	rsu_host_service_t *service = job->service;
 	rsu_host_server_t *server;
-	gchar *retval = NULL;
+	const gchar *address;
+	gchar *url;
 
-	server = g_hash_table_lookup(host_service->servers, device_if);
+	/* Runs in the main thread */
 
-	if (!server) {
-		server = prv_host_server_new(device_if, error);
+	if (job->cancelled) {
+		if (job->listener)
+			prv_post_command(service, RSU_HOST_COMMAND_DELETE,
+					 job->listener, NULL, NULL, NULL);
 
-		if (!server)
-			goto on_error;
+		job->error = g_error_new(RSU_ERROR, RSU_ERROR_CANCELLED,
+					 "Client has gone away");
+	}
+
+	if (job->error) {
+		job->cb(NULL, job->error, job->user_data);
+		goto on_exit;
+	}
+
+	if (job->update) {
+		url = prv_update_file(service, job);
+		job->cb(url, job->error, job->user_data);
+		g_free(url);
+		goto on_exit;
+	}
+
+	address = prv_server_address(service, job->device_if);
+	server = g_hash_table_lookup(service->servers, address);
+
+	if (!server && !job->listener) {
+
+		/* The server was shut down while the file was being
+		   probed, so the job needs to go round again and create
+		   a new one */
 
-		g_hash_table_insert(host_service->servers, g_strdup(device_if),
+		job->fd = job->hf->fd;
+		job->hf->fd = -1;
+		prv_host_file_delete(job->hf);
+		job->hf = NULL;
+		job->new_listener = TRUE;
+		prv_post_command(service, RSU_HOST_COMMAND_PROBE, NULL, NULL,
+				 NULL, job);
+		goto on_retry;
+	}
+
+	if (!server) {
+		server = prv_host_server_new(service, address, job->listener,
+					     job->port);
+		g_hash_table_insert(service->servers, server->device_if,
 				    server);
+	} else if (job->listener) {
+		prv_post_command(service, RSU_HOST_COMMAND_DELETE,
+				 job->listener, NULL, NULL, NULL);
+	}
+
+	url = prv_add_new_file(server, job);
+	job->cb(url, job->error, job->user_data);
+	g_free(url);
+
+on_exit:
+
+	(void) g_ptr_array_remove_fast(service->jobs, job);
+	prv_host_job_free(job);
+
+on_retry:
+
+	return FALSE;
+}
+
+static void prv_host_job_run(rsu_host_job_t *job)
+{
+	/* Runs in the worker thread */
+
+	if (job->fd >= 0) {
+		job->hf = prv_host_file_new_from_fd(job->fd, job->mime_type,
+						    job->live, &job->error);
+		if (job->hf)
+			job->fd = -1;
+	} else {
+		job->hf = prv_host_file_new(job->service->mime_cache,
+					    job->file, job->growing,
+					    &job->error);
 	}
 
-	retval = prv_add_new_file(server, client, device_if, file, error);
+	if (!job->hf)
+		goto on_error;
+
+	if (job->new_listener) {
+		job->listener = prv_host_listener_new(
+			job->service,
+			prv_server_address(job->service, job->device_if),
+			&job->error);
+		if (!job->listener)
+			goto on_error;
+
+		job->port = soup_server_get_port(job->listener->soup_server);
+	}
 
 on_error:
 
-	return retval;
+	(void) g_idle_add(prv_host_job_done_cb, job);
+}
+
+static rsu_host_job_t *prv_host_job_new(rsu_host_service_t *host_service,
+					const gchar *device_if,
+					const gchar *client,
+					rsu_host_service_add_cb_t cb,
+					gpointer user_data)
+{
+	rsu_host_job_t *job = g_new0(rsu_host_job_t, 1);
+
+	job->service = host_service;
+	job->device_if = g_strdup(device_if);
+	job->client = g_strdup(client);
+	job->fd = -1;
+	job->new_listener = !g_hash_table_lookup(
+		host_service->servers,
+		prv_server_address(host_service, device_if));
+	job->cb = cb;
+	job->user_data = user_data;
+	g_ptr_array_add(host_service->jobs, job);
+
+	return job;
+}
+
+void rsu_host_service_add(rsu_host_service_t *host_service,
+			  const gchar *device_if, const gchar *client,
+			  const gchar *file, gboolean growing,
+			  rsu_host_service_add_cb_t cb, gpointer user_data)
+{
+	rsu_host_job_t *job;
+
+	job = prv_host_job_new(host_service, device_if, client, cb,
+			       user_data);
+	job->file = g_strdup(file);
+	job->growing = growing;
+
+	prv_post_command(host_service, RSU_HOST_COMMAND_PROBE, NULL, NULL,
+			 NULL, job);
+}
+
+void rsu_host_service_add_fd(rsu_host_service_t *host_service,
+			     const gchar *device_if, const gchar *client,
+			     int fd, const gchar *mime_type, gboolean live,
+			     rsu_host_service_add_cb_t cb,
+			     gpointer user_data)
+{
+	rsu_host_job_t *job;
+
+	job = prv_host_job_new(host_service, device_if, client, cb,
+			       user_data);
+	job->fd = fd;
+	job->mime_type = g_strdup(mime_type);
+	job->live = live;
+
+	prv_post_command(host_service, RSU_HOST_COMMAND_PROBE, NULL, NULL,
+			 NULL, job);
+}
+
+static void prv_unhost_file(rsu_host_service_t *host_service,
+			    rsu_host_file_t *hf)
+{
+	rsu_host_server_t *server = hf->server;
+
+	prv_post_command(host_service, RSU_HOST_COMMAND_REMOVE,
+			 server->listener, g_strdup(hf->path), NULL, NULL);
+	g_hash_table_remove(server->files, hf->file);
+
+	if (g_hash_table_size(server->files) == 0)
+		g_hash_table_remove(host_service->servers, server->device_if);
+}
+
+void rsu_host_service_update(rsu_host_service_t *host_service,
+			     const gchar *device_if, const gchar *client,
+			     const gchar *file, rsu_host_service_add_cb_t cb,
+			     gpointer user_data)
+{
+	rsu_host_job_t *job;
+	rsu_host_server_t *server;
+	rsu_host_file_t *hf = NULL;
+
+	/* The new content is probed in the worker like a new file, but
+	   replaces the entry behind the existing URL.  A file that is
+	   being followed goes on being followed. */
+
+	job = prv_host_job_new(host_service, device_if, client, cb,
+			       user_data);
+	job->file = g_strdup(file);
+	job->new_listener = FALSE;
+	job->update = TRUE;
+
+	server = g_hash_table_lookup(host_service->servers,
+				     prv_server_address(host_service,
+							device_if));
+	if (server)
+		hf = g_hash_table_lookup(server->files, file);
+	if (hf)
+		job->growing = hf->growing;
+
+	prv_post_command(host_service, RSU_HOST_COMMAND_PROBE, NULL, NULL,
+			 NULL, job);
 }
 
 static gboolean prv_remove_client(rsu_host_service_t *host_service,
 				  const gchar *client,
-				  rsu_host_server_t *server,
-				  const gchar *device_if,
-				  const gchar *file,
 				  rsu_host_file_t *hf)
 {
-	unsigned int i;
+	GHashTable *files;
 	gboolean retval = FALSE;
 
-	for (i = 0; i < hf->clients->len; ++i)
-		if (!strcmp(g_ptr_array_index(hf->clients, i), client))
-			break;
-
-	if (i == hf->clients->len)
+	if (!g_hash_table_remove(hf->clients, client))
 		goto on_error;
 
-	g_ptr_array_remove_index(hf->clients, i);
+	files = g_hash_table_lookup(host_service->clients, client);
+	(void) g_hash_table_remove(files, hf);
+
+	if (g_hash_table_size(files) == 0)
+		(void) g_hash_table_remove(host_service->clients, client);
 
 	retval = TRUE;
 
@@ -365,27 +2365,34 @@ gboolean rsu_host_service_remove(rsu_host_service_t *host_service,
 	gboolean retval = FALSE;
 	rsu_host_file_t *hf;
 	rsu_host_server_t *server;
+	const gchar *path;
 
-	server = g_hash_table_lookup(host_service->servers, device_if);
+	server = g_hash_table_lookup(host_service->servers,
+				     prv_server_address(host_service,
+							device_if));
 
 	if (!server)
 		goto on_error;
 
 	hf = g_hash_table_lookup(server->files, file);
 
+	/* Content hosted from a descriptor is removed by its URL */
+
+	if (!hf) {
+		path = strstr(file, HOST_SERVICE_ROOT"/");
+		if (path)
+			hf = g_hash_table_lookup(server->files, path);
+	}
+
 	if (!hf)
 		goto on_error;
 
-	retval = prv_remove_client(host_service, client, server,
-				   device_if, file, hf);
+	retval = prv_remove_client(host_service, client, hf);
 	if (!retval)
 		goto on_error;
 
-	if (hf->clients->len == 0)
-		g_hash_table_remove(server->files, file);
-
-	if (g_hash_table_size(server->files) == 0)
-		g_hash_table_remove(host_service->servers, device_if);
+	if (g_hash_table_size(hf->clients) == 0)
+		prv_unhost_file(host_service, hf);
 
 on_error:
 
@@ -396,42 +2403,74 @@ void rsu_host_service_lost_client(rsu_host_service_t *host_service,
 				  const gchar *client)
 {
 	GHashTableIter iter;
-	GHashTableIter iter2;
-	gpointer value;
+	GHashTable *files;
 	gpointer key;
-	gpointer value2;
-	gpointer key2;
-	rsu_host_server_t *server;
+	gpointer value;
+	gchar *name;
 	rsu_host_file_t *hf;
+	rsu_host_job_t *job;
+	unsigned int i;
+
+	/* Files still being probed for the client are not hosted once
+	   the worker is done with them */
 
-	g_hash_table_iter_init(&iter, host_service->servers);
+	for (i = 0; i < host_service->jobs->len; ++i) {
+		job = g_ptr_array_index(host_service->jobs, i);
+		if (!strcmp(job->client, client))
+			job->cancelled = TRUE;
+	}
 
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		server = value;
-		g_hash_table_iter_init(&iter2, server->files);
+	/* Only the files of the lost client are visited */
 
-		while (g_hash_table_iter_next(&iter2, &key2, &value2)) {
-			hf = value2;
+	if (!g_hash_table_lookup_extended(host_service->clients, client,
+					  &key, &value))
+		goto on_exit;
 
-			if (!prv_remove_client(host_service, client, server,
-					       key, key2, hf))
-				continue;
+	name = key;
+	files = value;
+	(void) g_hash_table_steal(host_service->clients, client);
 
-			if (hf->clients->len > 0)
-				continue;
+	g_hash_table_iter_init(&iter, files);
 
-			g_hash_table_iter_remove(&iter2);
-		}
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		hf = key;
+		(void) g_hash_table_remove(hf->clients, name);
 
-		if (g_hash_table_size(server->files) == 0)
-			g_hash_table_iter_remove(&iter);
+		if (g_hash_table_size(hf->clients) == 0)
+			prv_unhost_file(host_service, hf);
 	}
+
+	g_hash_table_unref(files);
+	g_free(name);
+
+on_exit:
+
+	return;
 }
 
 void rsu_host_service_delete(rsu_host_service_t *host_service)
 {
 	if (host_service) {
+		g_hash_table_unref(host_service->clients);
 		g_hash_table_unref(host_service->servers);
+		g_ptr_array_unref(host_service->jobs);
+
+		prv_post_command(host_service, RSU_HOST_COMMAND_QUIT, NULL,
+				 NULL, NULL, NULL);
+		(void) g_thread_join(host_service->thread);
+
+		if (host_service->inotify_watch) {
+			g_source_destroy(host_service->inotify_watch);
+			g_source_unref(host_service->inotify_watch);
+			(void) close(host_service->inotify_fd);
+		}
+
+		g_hash_table_unref(host_service->followed);
+		g_async_queue_unref(host_service->commands);
+		rsu_mime_cache_delete(host_service->mime_cache);
+		g_queue_free(host_service->idle_mappings);
+		g_main_loop_unref(host_service->loop);
+		g_main_context_unref(host_service->context);
 		g_free(host_service);
 	}
 }
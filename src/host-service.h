@@ -23,12 +23,31 @@
 #ifndef RSU_HOST_SERVICE_H__
 #define RSU_HOST_SERVICE_H__
 
+#include "settings.h"
+
 typedef struct rsu_host_service_t_ rsu_host_service_t;
 
-void rsu_host_service_new(rsu_host_service_t **host_service);
-gchar *rsu_host_service_add(rsu_host_service_t *host_service,
-			    const gchar *device_if, const gchar *client,
-			    const gchar *file, GError **error);
+/* url is NULL if error is set */
+
+typedef void (*rsu_host_service_add_cb_t)(const gchar *url,
+					  const GError *error,
+					  gpointer user_data);
+
+void rsu_host_service_new(rsu_settings_context_t *settings,
+			  rsu_host_service_t **host_service);
+void rsu_host_service_add(rsu_host_service_t *host_service,
+			  const gchar *device_if, const gchar *client,
+			  const gchar *file, gboolean growing,
+			  rsu_host_service_add_cb_t cb, gpointer user_data);
+void rsu_host_service_add_fd(rsu_host_service_t *host_service,
+			     const gchar *device_if, const gchar *client,
+			     int fd, const gchar *mime_type, gboolean live,
+			     rsu_host_service_add_cb_t cb,
+			     gpointer user_data);
+void rsu_host_service_update(rsu_host_service_t *host_service,
+			     const gchar *device_if, const gchar *client,
+			     const gchar *file, rsu_host_service_add_cb_t cb,
+			     gpointer user_data);
 gboolean rsu_host_service_remove(rsu_host_service_t *host_service,
 				 const gchar *device_if, const gchar *client,
 				 const gchar *file);
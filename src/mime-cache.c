@@ -0,0 +1,222 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+
+#include <string.h>
+
+#include "error.h"
+#include "log.h"
+#include "mime-cache.h"
+
+/* Number of extensions whose types are remembered */
+#define RSU_MIME_CACHE_SIZE 256
+
+/* Number of lookups between two reports of the hit rate */
+#define RSU_MIME_CACHE_REPORT_INTERVAL 1000
+
+/* DLNA.ORG_FLAGS: streaming or interactive transfer mode, background
+   transfer mode, connection stalling and DLNA 1.5 */
+#define RSU_MIME_DLNA_FLAGS_STREAMING 0x01700000
+#define RSU_MIME_DLNA_FLAGS_INTERACTIVE 0x00d00000
+
+/* The type is guessed from the name of the file alone, and in
+   practice only its extension decides the result.  Types are
+   therefore cached by lower cased extension, so every new photo
+   pushed to a renderer hits the cache.  A name without an extension
+   is its own key. */
+
+typedef struct rsu_mime_entry_t_ rsu_mime_entry_t;
+struct rsu_mime_entry_t_ {
+	gchar *key;
+	rsu_mime_type_t type;
+	GList *link;
+};
+
+struct rsu_mime_cache_t_ {
+	GHashTable *entries;
+	GQueue lru;
+	guint hits;
+	guint misses;
+};
+
+static void prv_entry_free(gpointer data)
+{
+	rsu_mime_entry_t *entry = data;
+
+	g_free(entry->key);
+	g_free(entry->type.mime_type);
+	g_free(entry->type.content_features);
+	g_free(entry);
+}
+
+static gchar *prv_make_key(const gchar *file)
+{
+	const gchar *name;
+	const gchar *extension;
+
+	name = strrchr(file, '/');
+	name = name ? name + 1 : file;
+
+	extension = strrchr(name, '.');
+
+	return extension ? g_ascii_strdown(extension, -1) : g_strdup(name);
+}
+
+static gchar *prv_guess_mime_type(const gchar *file, GError **error)
+{
+	gchar *content_type;
+	gchar *mime_type = NULL;
+
+	content_type = g_content_type_guess(file, NULL, 0, NULL);
+
+	if (!content_type) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_MIME,
+				     "Unable to determine Content Type for"
+				     " %s", file);
+		goto on_error;
+	}
+
+	mime_type = g_content_type_get_mime_type(content_type);
+
+	if (!mime_type)
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_MIME,
+				     "Unable to determine MIME Type for"
+				     " %s", file);
+
+on_error:
+
+	g_free(content_type);
+
+	return mime_type;
+}
+
+void rsu_mime_type_set_dlna_headers(rsu_mime_type_t *type,
+				    gboolean seekable)
+{
+	guint flags;
+
+	if (g_str_has_prefix(type->mime_type, "audio/") ||
+	    g_str_has_prefix(type->mime_type, "video/")) {
+		type->transfer_mode = "Streaming";
+		flags = RSU_MIME_DLNA_FLAGS_STREAMING;
+	} else {
+		type->transfer_mode = "Interactive";
+		flags = RSU_MIME_DLNA_FLAGS_INTERACTIVE;
+	}
+
+	type->content_features = g_strdup_printf(
+		"DLNA.ORG_OP=%s;DLNA.ORG_CI=0;DLNA.ORG_FLAGS=%08x%024d",
+		seekable ? "01" : "00", flags, 0);
+}
+
+static void prv_report(rsu_mime_cache_t *cache)
+{
+	guint lookups = cache->hits + cache->misses;
+
+	if (lookups == 0)
+		goto on_exit;
+
+	RSU_LOG_DEBUG("MIME cache: %u lookups, %u%% hits, %u entries",
+		      lookups, cache->hits * 100 / lookups,
+		      g_hash_table_size(cache->entries));
+
+on_exit:
+
+	return;
+}
+
+rsu_mime_cache_t *rsu_mime_cache_new(void)
+{
+	rsu_mime_cache_t *cache = g_new0(rsu_mime_cache_t, 1);
+
+	cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+					       NULL, prv_entry_free);
+	g_queue_init(&cache->lru);
+
+	return cache;
+}
+
+void rsu_mime_cache_delete(rsu_mime_cache_t *cache)
+{
+	if (cache) {
+		prv_report(cache);
+		g_queue_clear(&cache->lru);
+		g_hash_table_unref(cache->entries);
+		g_free(cache);
+	}
+}
+
+const rsu_mime_type_t *rsu_mime_cache_lookup(rsu_mime_cache_t *cache,
+					     const gchar *file,
+					     GError **error)
+{
+	rsu_mime_entry_t *entry;
+	rsu_mime_entry_t *oldest;
+	gchar *mime_type;
+	gchar *key;
+
+	key = prv_make_key(file);
+	entry = g_hash_table_lookup(cache->entries, key);
+
+	if (entry) {
+		++cache->hits;
+
+		/* Most recently used entries are kept at the head */
+
+		g_queue_unlink(&cache->lru, entry->link);
+		g_queue_push_head_link(&cache->lru, entry->link);
+		goto on_exit;
+	}
+
+	++cache->misses;
+
+	mime_type = prv_guess_mime_type(file, error);
+	if (!mime_type)
+		goto on_exit;
+
+	if (g_hash_table_size(cache->entries) >= RSU_MIME_CACHE_SIZE) {
+		oldest = g_queue_pop_tail(&cache->lru);
+		g_hash_table_remove(cache->entries, oldest->key);
+	}
+
+	entry = g_new0(rsu_mime_entry_t, 1);
+	entry->key = key;
+	key = NULL;
+	entry->type.mime_type = mime_type;
+	rsu_mime_type_set_dlna_headers(&entry->type, TRUE);
+
+	g_queue_push_head(&cache->lru, entry);
+	entry->link = cache->lru.head;
+	g_hash_table_insert(cache->entries, entry->key, entry);
+
+on_exit:
+
+	g_free(key);
+
+	if ((cache->hits + cache->misses) %
+	    RSU_MIME_CACHE_REPORT_INTERVAL == 0)
+		prv_report(cache);
+
+	return entry ? &entry->type : NULL;
+}
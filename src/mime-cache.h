@@ -0,0 +1,55 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+#ifndef RSU_MIME_CACHE_H__
+#define RSU_MIME_CACHE_H__
+
+#include <glib.h>
+
+typedef struct rsu_mime_cache_t_ rsu_mime_cache_t;
+
+typedef struct rsu_mime_type_t_ rsu_mime_type_t;
+struct rsu_mime_type_t_ {
+	gchar *mime_type;
+	const gchar *transfer_mode;
+	gchar *content_features;
+};
+
+rsu_mime_cache_t *rsu_mime_cache_new(void);
+void rsu_mime_cache_delete(rsu_mime_cache_t *cache);
+
+/* The result belongs to the cache and is only valid until the next
+   lookup */
+
+const rsu_mime_type_t *rsu_mime_cache_lookup(rsu_mime_cache_t *cache,
+					     const gchar *file,
+					     GError **error);
+
+/* Fills in the DLNA transfer mode and content features of a type
+   whose MIME type is already set.  Content that is not seekable does
+   not advertise byte range support. */
+
+void rsu_mime_type_set_dlna_headers(rsu_mime_type_t *type,
+				    gboolean seekable);
+
+#endif
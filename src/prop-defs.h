@@ -35,6 +35,8 @@
 #define RSU_INTERFACE_PROP_SUPPORTED_URIS "SupportedUriSchemes"
 #define RSU_INTERFACE_PROP_SUPPORTED_MIME "SupportedMimeTypes"
 #define RSU_INTERFACE_PROP_PROTOCOL_INFO "ProtocolInfo"
+#define RSU_INTERFACE_PROP_SUBSCRIPTION_FAILURES "SubscriptionFailures"
+#define RSU_INTERFACE_PROP_SUBSCRIPTION_LATENCY "SubscriptionLatency"
 
 #define RSU_INTERFACE_PROP_PLAYBACK_STATUS "PlaybackStatus"
 #define RSU_INTERFACE_PROP_RATE "Rate"
@@ -49,5 +51,6 @@
 #define RSU_INTERFACE_PROP_MINIMUM_RATE "MinimumRate"
 #define RSU_INTERFACE_PROP_MAXIMUM_RATE "MaximumRate"
 #define RSU_INTERFACE_PROP_VOLUME "Volume"
+#define RSU_INTERFACE_PROP_MUTE "Mute"
 
 #endif
@@ -0,0 +1,548 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "error.h"
+#include "protocol-info.h"
+
+/* Tokens shorter than this are lower cased on the stack */
+#define RSU_PROTOCOL_INFO_TOKEN_MAX 128
+
+typedef struct rsu_protocol_info_set_t_ rsu_protocol_info_set_t;
+struct rsu_protocol_info_set_t_ {
+	GHashTable *index;
+	GPtrArray *values;
+};
+
+/* The fields of one protocol info entry that are of interest.  They
+   point into the sets of values of the protocol info.  profile is NULL
+   if the entry names no DLNA profile and "*" if it accepts any. */
+
+struct rsu_protocol_info_entry_t_ {
+	const gchar *protocol;
+	const gchar *type;
+	const gchar *profile;
+};
+
+/* The per-field tables only narrow down the renderers to check.  A
+   renderer matches if one of its entries matches every field, so
+   paths maps each renderer to its protocol info. */
+
+struct rsu_protocol_info_index_t_ {
+	GHashTable *paths;
+	GHashTable *protocols;
+	GHashTable *types;
+	GHashTable *profiles;
+};
+
+/* Parsed SinkProtocolInfo strings shared by all devices that advertise
+   exactly the same string.  Entries are removed when their last
+   reference is released. */
+static GHashTable *g_protocol_info_cache;
+
+static void prv_set_init(rsu_protocol_info_set_t *set)
+{
+	set->values = g_ptr_array_new_with_free_func(g_free);
+	set->index = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+static void prv_set_free(rsu_protocol_info_set_t *set)
+{
+	g_hash_table_unref(set->index);
+	g_ptr_array_unref(set->values);
+}
+
+static const gchar *prv_set_add(rsu_protocol_info_set_t *set,
+				const gchar *token, gsize len)
+{
+	gchar buffer[RSU_PROTOCOL_INFO_TOKEN_MAX];
+	gchar *lower;
+	gpointer found;
+	gsize i;
+
+	if (len < sizeof(buffer)) {
+		for (i = 0; i < len; ++i)
+			buffer[i] = g_ascii_tolower(token[i]);
+		buffer[len] = 0;
+
+		if (g_hash_table_lookup_extended(set->index, buffer, &found,
+						 NULL)) {
+			lower = found;
+			goto on_exit;
+		}
+
+		lower = g_strndup(buffer, len);
+	} else {
+		lower = g_ascii_strdown(token, len);
+
+		if (g_hash_table_lookup_extended(set->index, lower, &found,
+						 NULL)) {
+			g_free(lower);
+			lower = found;
+			goto on_exit;
+		}
+	}
+
+	g_ptr_array_add(set->values, lower);
+	g_hash_table_insert(set->index, lower, NULL);
+
+on_exit:
+
+	return lower;
+}
+
+static GVariant *prv_set_to_variant(rsu_protocol_info_set_t *set)
+{
+	GVariantBuilder vb;
+	unsigned int i;
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("as"));
+
+	for (i = 0; i < set->values->len; ++i)
+		g_variant_builder_add(&vb, "s",
+				      g_ptr_array_index(set->values, i));
+
+	return g_variant_ref_sink(g_variant_builder_end(&vb));
+}
+
+static const gchar *prv_trim(const gchar *start, const gchar *end,
+			     gsize *len)
+{
+	while (start < end && g_ascii_isspace(*start))
+		++start;
+
+	while (end > start && g_ascii_isspace(end[-1]))
+		--end;
+
+	*len = end - start;
+
+	return start;
+}
+
+static gboolean prv_parse_entry(const gchar *entry, const gchar *entry_end,
+				rsu_protocol_info_set_t *protocols,
+				rsu_protocol_info_set_t *types,
+				rsu_protocol_info_set_t *profiles,
+				GArray *entries)
+{
+	rsu_protocol_info_entry_t parsed = { NULL, NULL, NULL };
+	gboolean retval = FALSE;
+	const char http_prefix[] = "http-";
+	const char profile_prefix[] = "DLNA.ORG_PN=";
+	const gchar *first;
+	const gchar *second;
+	const gchar *third;
+	const gchar *token;
+	const gchar *token_end;
+	gsize len;
+
+	/* A protocol info entry is <protocol>:<network>:<type>:<info>.
+	   The protocol, the content type and the DLNA profile, if any,
+	   are of interest here. */
+
+	first = memchr(entry, ':', entry_end - entry);
+	if (!first)
+		goto on_exit;
+
+	second = memchr(first + 1, ':', entry_end - first - 1);
+	if (!second)
+		goto on_exit;
+
+	third = memchr(second + 1, ':', entry_end - second - 1);
+	if (!third)
+		third = entry_end;
+
+	token = prv_trim(entry, first, &len);
+	if (len >= sizeof(http_prefix) - 1 &&
+	    !g_ascii_strncasecmp(http_prefix, token, sizeof(http_prefix) - 1))
+		len = sizeof(http_prefix) - 2;
+	parsed.protocol = prv_set_add(protocols, token, len);
+
+	token = prv_trim(second + 1, third, &len);
+	parsed.type = prv_set_add(types, token, len);
+
+	if (third == entry_end)
+		goto on_add;
+
+	/* A renderer that accepts any additional information accepts
+	   any profile */
+
+	token = prv_trim(third + 1, entry_end, &len);
+	if (len == 1 && token[0] == '*') {
+		parsed.profile = prv_set_add(profiles, token, len);
+		goto on_add;
+	}
+
+	token = g_strstr_len(third + 1, entry_end - third - 1, profile_prefix);
+	if (!token)
+		goto on_add;
+
+	token += sizeof(profile_prefix) - 1;
+	token_end = memchr(token, ';', entry_end - token);
+	if (!token_end)
+		token_end = entry_end;
+
+	token = prv_trim(token, token_end, &len);
+	if (len > 0)
+		parsed.profile = prv_set_add(profiles, token, len);
+
+on_add:
+
+	if (entries)
+		g_array_append_val(entries, parsed);
+
+	retval = TRUE;
+
+on_exit:
+
+	return retval;
+}
+
+static void prv_parse(const gchar *protocol_info,
+		      rsu_protocol_info_set_t *protocols,
+		      rsu_protocol_info_set_t *types,
+		      rsu_protocol_info_set_t *profiles,
+		      GArray *entries)
+{
+	const gchar *entry = protocol_info;
+	const gchar *end = entry + strlen(entry);
+	const gchar *entry_end;
+
+	/* The string is tokenized in place.  memchr is used to locate the
+	   separators as it is vectorized by most C libraries. */
+
+	while (entry < end) {
+		entry_end = memchr(entry, ',', end - entry);
+		if (!entry_end)
+			entry_end = end;
+
+		(void) prv_parse_entry(entry, entry_end, protocols, types,
+				       profiles, entries);
+
+		entry = entry_end + 1;
+	}
+}
+
+static void prv_parse_protocol_info(rsu_protocol_info_t *info)
+{
+	rsu_protocol_info_set_t protocols;
+	rsu_protocol_info_set_t types;
+	rsu_protocol_info_set_t profiles;
+
+	prv_set_init(&protocols);
+	prv_set_init(&types);
+	prv_set_init(&profiles);
+
+	info->entries = g_array_new(FALSE, FALSE,
+				    sizeof(rsu_protocol_info_entry_t));
+	prv_parse(info->protocol_info, &protocols, &types, &profiles,
+		  info->entries);
+
+	info->uri_schemes = prv_set_to_variant(&protocols);
+	info->mime_types = prv_set_to_variant(&types);
+
+	info->protocols = g_ptr_array_ref(protocols.values);
+	info->types = g_ptr_array_ref(types.values);
+	info->profiles = g_ptr_array_ref(profiles.values);
+
+	prv_set_free(&profiles);
+	prv_set_free(&types);
+	prv_set_free(&protocols);
+}
+
+static void prv_protocol_info_delete(rsu_protocol_info_t *info)
+{
+	g_array_unref(info->entries);
+	g_ptr_array_unref(info->profiles);
+	g_ptr_array_unref(info->types);
+	g_ptr_array_unref(info->protocols);
+	g_variant_unref(info->mime_types);
+	g_variant_unref(info->uri_schemes);
+	g_variant_unref(info->protocol_info_val);
+	g_free(info->protocol_info);
+	g_free(info);
+}
+
+rsu_protocol_info_t *rsu_protocol_info_get(const gchar *protocol_info)
+{
+	rsu_protocol_info_t *info;
+
+	if (!g_protocol_info_cache)
+		g_protocol_info_cache = g_hash_table_new(g_str_hash,
+							 g_str_equal);
+
+	info = g_hash_table_lookup(g_protocol_info_cache, protocol_info);
+
+	if (info) {
+		++info->ref_count;
+	} else {
+		info = g_new0(rsu_protocol_info_t, 1);
+		info->ref_count = 1;
+		info->protocol_info = g_strdup(protocol_info);
+		info->protocol_info_val = g_variant_ref_sink(
+			g_variant_new_string(protocol_info));
+		prv_parse_protocol_info(info);
+
+		g_hash_table_insert(g_protocol_info_cache, info->protocol_info,
+				    info);
+	}
+
+	return info;
+}
+
+void rsu_protocol_info_unref(rsu_protocol_info_t *info)
+{
+	if (info && --info->ref_count == 0) {
+		g_hash_table_remove(g_protocol_info_cache, info->protocol_info);
+
+		if (g_hash_table_size(g_protocol_info_cache) == 0) {
+			g_hash_table_unref(g_protocol_info_cache);
+			g_protocol_info_cache = NULL;
+		}
+
+		prv_protocol_info_delete(info);
+	}
+}
+
+static GHashTable *prv_index_table_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				     (GDestroyNotify) g_hash_table_unref);
+}
+
+rsu_protocol_info_index_t *rsu_protocol_info_index_new(void)
+{
+	rsu_protocol_info_index_t *index;
+
+	index = g_new(rsu_protocol_info_index_t, 1);
+	index->paths = g_hash_table_new(g_str_hash, g_str_equal);
+	index->protocols = prv_index_table_new();
+	index->types = prv_index_table_new();
+	index->profiles = prv_index_table_new();
+
+	return index;
+}
+
+void rsu_protocol_info_index_delete(rsu_protocol_info_index_t *index)
+{
+	if (index) {
+		g_hash_table_unref(index->profiles);
+		g_hash_table_unref(index->types);
+		g_hash_table_unref(index->protocols);
+		g_hash_table_unref(index->paths);
+		g_free(index);
+	}
+}
+
+static void prv_index_add(GHashTable *table, GPtrArray *keys,
+			  const gchar *path)
+{
+	GHashTable *paths;
+	unsigned int i;
+	const gchar *key;
+
+	for (i = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index(keys, i);
+		paths = g_hash_table_lookup(table, key);
+
+		if (!paths) {
+			paths = g_hash_table_new(g_str_hash, g_str_equal);
+			g_hash_table_insert(table, g_strdup(key), paths);
+		}
+
+		g_hash_table_insert(paths, (gchar *) path, NULL);
+	}
+}
+
+static void prv_index_remove(GHashTable *table, GPtrArray *keys,
+			     const gchar *path)
+{
+	GHashTable *paths;
+	unsigned int i;
+	const gchar *key;
+
+	for (i = 0; i < keys->len; ++i) {
+		key = g_ptr_array_index(keys, i);
+		paths = g_hash_table_lookup(table, key);
+
+		if (!paths)
+			continue;
+
+		g_hash_table_remove(paths, path);
+
+		if (g_hash_table_size(paths) == 0)
+			g_hash_table_remove(table, key);
+	}
+}
+
+void rsu_protocol_info_index_update(rsu_protocol_info_index_t *index,
+				    const gchar *path,
+				    rsu_protocol_info_t *old_info,
+				    rsu_protocol_info_t *new_info)
+{
+	if (old_info) {
+		prv_index_remove(index->protocols, old_info->protocols, path);
+		prv_index_remove(index->types, old_info->types, path);
+		prv_index_remove(index->profiles, old_info->profiles, path);
+		g_hash_table_remove(index->paths, path);
+	}
+
+	if (new_info) {
+		prv_index_add(index->protocols, new_info->protocols, path);
+		prv_index_add(index->types, new_info->types, path);
+		prv_index_add(index->profiles, new_info->profiles, path);
+		g_hash_table_insert(index->paths, (gchar *) path, new_info);
+	}
+}
+
+static gboolean prv_is_wildcard(GPtrArray *keys)
+{
+	const gchar *key;
+
+	if (keys->len == 0)
+		return TRUE;
+
+	key = g_ptr_array_index(keys, 0);
+
+	return !key[0] || !strcmp(key, "*");
+}
+
+static gboolean prv_field_match(const gchar *value, GPtrArray *keys)
+{
+	/* An empty or * field in the query matches everything.  A * in a
+	   renderer's protocol info matches any query value. */
+
+	if (prv_is_wildcard(keys))
+		return TRUE;
+
+	return value && (!strcmp(value, "*") ||
+			 !strcmp(value, g_ptr_array_index(keys, 0)));
+}
+
+static gboolean prv_info_match(rsu_protocol_info_t *info,
+			       rsu_protocol_info_set_t *protocols,
+			       rsu_protocol_info_set_t *types,
+			       rsu_protocol_info_set_t *profiles)
+{
+	rsu_protocol_info_entry_t *entry;
+	unsigned int i;
+
+	/* All fields must be accepted by the same entry */
+
+	for (i = 0; i < info->entries->len; ++i) {
+		entry = &g_array_index(info->entries,
+				       rsu_protocol_info_entry_t, i);
+
+		if (prv_field_match(entry->protocol, protocols->values) &&
+		    prv_field_match(entry->type, types->values) &&
+		    prv_field_match(entry->profile, profiles->values))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static GHashTable *prv_index_candidates(GHashTable *table, GPtrArray *keys,
+					GHashTable *smallest)
+{
+	GHashTable *paths;
+
+	if (prv_is_wildcard(keys))
+		goto on_exit;
+
+	paths = g_hash_table_lookup(table, g_ptr_array_index(keys, 0));
+
+	/* If no renderer lists the value explicitly only renderers that
+	   accept * can match, so they must all be considered. */
+
+	if (paths && g_hash_table_lookup(table, "*") == NULL &&
+	    g_hash_table_size(paths) < g_hash_table_size(smallest))
+		smallest = paths;
+
+on_exit:
+
+	return smallest;
+}
+
+GVariant *rsu_protocol_info_index_lookup(rsu_protocol_info_index_t *index,
+					 const gchar *protocol_info,
+					 GError **error)
+{
+	GVariant *retval = NULL;
+	GVariantBuilder vb;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer info;
+	GHashTable *candidates;
+	rsu_protocol_info_set_t protocols;
+	rsu_protocol_info_set_t types;
+	rsu_protocol_info_set_t profiles;
+
+	prv_set_init(&protocols);
+	prv_set_init(&types);
+	prv_set_init(&profiles);
+
+	/* The query is a single protocol info entry.  Its fields are
+	   normalized exactly as the renderers' SinkProtocolInfo entries
+	   are so that they can be looked up directly in the index.  A
+	   query without a protocol, network and content type would match
+	   every renderer, so it is rejected. */
+
+	if (!prv_parse_entry(protocol_info,
+			     protocol_info + strlen(protocol_info),
+			     &protocols, &types, &profiles, NULL)) {
+		*error = g_error_new(RSU_ERROR, RSU_ERROR_BAD_VALUE,
+				     "ProtocolInfo must be of the form "
+				     "<protocol>:<network>:<type>:<info>");
+		goto on_error;
+	}
+
+	candidates = prv_index_candidates(index->protocols, protocols.values,
+					  index->paths);
+	candidates = prv_index_candidates(index->types, types.values,
+					  candidates);
+	candidates = prv_index_candidates(index->profiles, profiles.values,
+					  candidates);
+
+	g_variant_builder_init(&vb, G_VARIANT_TYPE("as"));
+	g_hash_table_iter_init(&iter, candidates);
+
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		info = g_hash_table_lookup(index->paths, key);
+
+		if (prv_info_match(info, &protocols, &types, &profiles))
+			g_variant_builder_add(&vb, "s", key);
+	}
+
+	retval = g_variant_ref_sink(g_variant_builder_end(&vb));
+
+on_error:
+
+	prv_set_free(&profiles);
+	prv_set_free(&types);
+	prv_set_free(&protocols);
+
+	return retval;
+}
@@ -0,0 +1,59 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+#ifndef RSU_PROTOCOL_INFO_H__
+#define RSU_PROTOCOL_INFO_H__
+
+#include <glib.h>
+
+typedef struct rsu_protocol_info_entry_t_ rsu_protocol_info_entry_t;
+
+typedef struct rsu_protocol_info_t_ rsu_protocol_info_t;
+struct rsu_protocol_info_t_ {
+	guint ref_count;
+	gchar *protocol_info;
+	GVariant *protocol_info_val;
+	GVariant *uri_schemes;
+	GVariant *mime_types;
+	GPtrArray *protocols;
+	GPtrArray *types;
+	GPtrArray *profiles;
+	GArray *entries;
+};
+
+typedef struct rsu_protocol_info_index_t_ rsu_protocol_info_index_t;
+
+rsu_protocol_info_t *rsu_protocol_info_get(const gchar *protocol_info);
+void rsu_protocol_info_unref(rsu_protocol_info_t *info);
+
+rsu_protocol_info_index_t *rsu_protocol_info_index_new(void);
+void rsu_protocol_info_index_delete(rsu_protocol_info_index_t *index);
+void rsu_protocol_info_index_update(rsu_protocol_info_index_t *index,
+				    const gchar *path,
+				    rsu_protocol_info_t *old_info,
+				    rsu_protocol_info_t *new_info);
+GVariant *rsu_protocol_info_index_lookup(rsu_protocol_info_index_t *index,
+					 const gchar *protocol_info,
+					 GError **error);
+
+#endif
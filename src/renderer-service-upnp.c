@@ -39,6 +39,7 @@
 
 #define RSU_INTERFACE_GET_VERSION "GetVersion"
 #define RSU_INTERFACE_GET_SERVERS "GetServers"
+#define RSU_INTERFACE_GET_COMPATIBLE_SERVERS "GetCompatibleServers"
 #define RSU_INTERFACE_RELEASE "Release"
 
 #define RSU_INTERFACE_FOUND_SERVER "FoundServer"
@@ -46,16 +47,24 @@
 
 #define RSU_INTERFACE_HOST_FILE "HostFile"
 #define RSU_INTERFACE_REMOVE_FILE "RemoveFile"
+#define RSU_INTERFACE_UPDATE_FILE "UpdateFile"
+#define RSU_INTERFACE_HOST_FD "HostFd"
+#define RSU_INTERFACE_HOST_STREAM "HostStream"
+#define RSU_INTERFACE_HOST_GROWING_FILE "HostGrowingFile"
 
 #define RSU_INTERFACE_VERSION "Version"
 #define RSU_INTERFACE_SERVERS "Servers"
+#define RSU_INTERFACE_PROTOCOL_INFO "ProtocolInfo"
 
 #define RSU_INTERFACE_PATH "Path"
 #define RSU_INTERFACE_URI "Uri"
 #define RSU_INTERFACE_ID "Id"
+#define RSU_INTERFACE_FD "Fd"
+#define RSU_INTERFACE_MIME_TYPE "MimeType"
 
 #define RSU_INTERFACE_GET "Get"
 #define RSU_INTERFACE_GET_ALL "GetAll"
+#define RSU_INTERFACE_SET "Set"
 #define RSU_INTERFACE_INTERFACE_NAME "interface_name"
 #define RSU_INTERFACE_PROPERTY_NAME "property_name"
 #define RSU_INTERFACE_PROPERTIES_VALUE "properties"
@@ -108,6 +117,12 @@ static const gchar g_rsu_root_introspection[] =
 	"      <arg type='as' name='"RSU_INTERFACE_SERVERS"'"
 	"           direction='out'/>"
 	"    </method>"
+	"    <method name='"RSU_INTERFACE_GET_COMPATIBLE_SERVERS"'>"
+	"      <arg type='s' name='"RSU_INTERFACE_PROTOCOL_INFO"'"
+	"           direction='in'/>"
+	"      <arg type='as' name='"RSU_INTERFACE_SERVERS"'"
+	"           direction='out'/>"
+	"    </method>"
 	"    <signal name='"RSU_INTERFACE_FOUND_SERVER"'>"
 	"      <arg type='s' name='"RSU_INTERFACE_PATH"'/>"
 	"    </signal>"
@@ -134,6 +149,14 @@ static const gchar g_rsu_server_introspection[] =
 	"      <arg type='a{sv}' name='"RSU_INTERFACE_PROPERTIES_VALUE"'"
 	"           direction='out'/>"
 	"    </method>"
+	"    <method name='"RSU_INTERFACE_SET"'>"
+	"      <arg type='s' name='"RSU_INTERFACE_INTERFACE_NAME"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_PROPERTY_NAME"'"
+	"           direction='in'/>"
+	"      <arg type='v' name='"RSU_INTERFACE_VALUE"'"
+	"           direction='in'/>"
+	"    </method>"
 	"  </interface>"
 	"  <interface name='"RSU_INTERFACE_SERVER"'>"
 	"    <method name='"RSU_INTERFACE_RAISE"'>"
@@ -156,6 +179,12 @@ static const gchar g_rsu_server_introspection[] =
 	"       access='read'/>"
 	"    <property type='s' name='"RSU_INTERFACE_PROP_PROTOCOL_INFO"'"
 	"       access='read'/>"
+	"    <property type='u'"
+	"       name='"RSU_INTERFACE_PROP_SUBSCRIPTION_FAILURES"'"
+	"       access='read'/>"
+	"    <property type='x'"
+	"       name='"RSU_INTERFACE_PROP_SUBSCRIPTION_LATENCY"'"
+	"       access='read'/>"
 	"  </interface>"
 	"  <interface name='"RSU_INTERFACE_PLAYER"'>"
 	"    <method name='"RSU_INTERFACE_PLAY"'>"
@@ -187,12 +216,14 @@ static const gchar g_rsu_server_introspection[] =
 	"    <property type='s' name='"RSU_INTERFACE_PROP_PLAYBACK_STATUS"'"
 	"       access='read'/>"
 	"    <property type='d' name='"RSU_INTERFACE_PROP_RATE"'"
-	"       access='read'/>"
+	"       access='readwrite'/>"
 	"    <property type='d' name='"RSU_INTERFACE_PROP_MINIMUM_RATE"'"
 	"       access='read'/>"
 	"    <property type='d' name='"RSU_INTERFACE_PROP_MAXIMUM_RATE"'"
 	"       access='read'/>"
 	"    <property type='d' name='"RSU_INTERFACE_PROP_VOLUME"'"
+	"       access='readwrite'/>"
+	"    <property type='b' name='"RSU_INTERFACE_PROP_MUTE"'"
 	"       access='read'/>"
 	"    <property type='b' name='"RSU_INTERFACE_PROP_CAN_PLAY"'"
 	"       access='read'/>"
@@ -222,6 +253,34 @@ static const gchar g_rsu_server_introspection[] =
 	"      <arg type='s' name='"RSU_INTERFACE_PATH"'"
 	"           direction='in'/>"
 	"    </method>"
+	"    <method name='"RSU_INTERFACE_UPDATE_FILE"'>"
+	"      <arg type='s' name='"RSU_INTERFACE_PATH"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_URI"'"
+	"           direction='out'/>"
+	"    </method>"
+	"    <method name='"RSU_INTERFACE_HOST_FD"'>"
+	"      <arg type='h' name='"RSU_INTERFACE_FD"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_MIME_TYPE"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_URI"'"
+	"           direction='out'/>"
+	"    </method>"
+	"    <method name='"RSU_INTERFACE_HOST_STREAM"'>"
+	"      <arg type='h' name='"RSU_INTERFACE_FD"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_MIME_TYPE"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_URI"'"
+	"           direction='out'/>"
+	"    </method>"
+	"    <method name='"RSU_INTERFACE_HOST_GROWING_FILE"'>"
+	"      <arg type='s' name='"RSU_INTERFACE_PATH"'"
+	"           direction='in'/>"
+	"      <arg type='s' name='"RSU_INTERFACE_URI"'"
+	"           direction='out'/>"
+	"    </method>"
 	"  </interface>"
 	"</node>";
 
@@ -317,7 +376,7 @@ static void prv_free_rsu_task_cb(gpointer data, gpointer user_data)
 
 static void prv_process_sync_task(rsu_context_t *context, rsu_task_t *task)
 {
-	GError *error;
+	GError *error = NULL;
 
 	switch (task->type) {
 	case RSU_TASK_GET_VERSION:
@@ -327,6 +386,17 @@ static void prv_process_sync_task(rsu_context_t *context, rsu_task_t *task)
 		task->result = rsu_upnp_get_server_ids(context->upnp);
 		rsu_task_complete_and_delete(task);
 		break;
+	case RSU_TASK_GET_COMPATIBLE_SERVERS:
+		task->result = rsu_upnp_get_compatible_server_ids(
+			context->upnp,
+			task->ut.get_compatible_servers.protocol_info, &error);
+		if (!error) {
+			rsu_task_complete_and_delete(task);
+		} else {
+			rsu_task_fail_and_delete(task, error);
+			g_error_free(error);
+		}
+		break;
 	case RSU_TASK_RAISE:
 	case RSU_TASK_QUIT:
 		error = g_error_new(RSU_ERROR, RSU_ERROR_NOT_SUPPORTED,
@@ -376,6 +446,11 @@ static void prv_process_async_task(rsu_context_t *context, rsu_task_t *task)
 				       context->cancellable,
 				       prv_async_task_complete, context);
 		break;
+	case RSU_TASK_SET_PROP:
+		rsu_upnp_set_prop(context->upnp, task,
+				  context->cancellable,
+				  prv_async_task_complete, context);
+		break;
 	case RSU_TASK_PLAY:
 		rsu_upnp_play(context->upnp, task,
 			      context->cancellable,
@@ -422,6 +497,7 @@ static void prv_process_async_task(rsu_context_t *context, rsu_task_t *task)
 				      prv_async_task_complete, context);
 		break;
 	case RSU_TASK_HOST_URI:
+	case RSU_TASK_HOST_GROWING_URI:
 		rsu_upnp_host_uri(context->upnp, task,
 				  context->cancellable,
 				  prv_async_task_complete, context);
@@ -431,6 +507,17 @@ static void prv_process_async_task(rsu_context_t *context, rsu_task_t *task)
 				    context->cancellable,
 				    prv_async_task_complete, context);
 		break;
+	case RSU_TASK_UPDATE_URI:
+		rsu_upnp_update_uri(context->upnp, task,
+				    context->cancellable,
+				    prv_async_task_complete, context);
+		break;
+	case RSU_TASK_HOST_FD:
+	case RSU_TASK_HOST_STREAM:
+		rsu_upnp_host_fd(context->upnp, task,
+				 context->cancellable,
+				 prv_async_task_complete, context);
+		break;
 	default:
 		break;
 	}
@@ -577,6 +664,9 @@ static void prv_rsu_method_call(GDBusConnection *conn,
 			task = rsu_task_get_version_new(invocation);
 		else if (!strcmp(method, RSU_INTERFACE_GET_SERVERS))
 			task = rsu_task_get_servers_new(invocation);
+		else if (!strcmp(method, RSU_INTERFACE_GET_COMPATIBLE_SERVERS))
+			task = rsu_task_get_compatible_servers_new(invocation,
+								   parameters);
 		else
 			goto finished;
 
@@ -604,6 +694,8 @@ static void prv_props_method_call(GDBusConnection *conn,
 		task = rsu_task_get_props_new(invocation, object, parameters);
 	else if (!strcmp(method, RSU_INTERFACE_GET))
 		task = rsu_task_get_prop_new(invocation, object, parameters);
+	else if (!strcmp(method, RSU_INTERFACE_SET))
+		task = rsu_task_set_prop_new(invocation, object, parameters);
 	else
 		goto finished;
 
@@ -699,6 +791,16 @@ static void prv_rsu_push_host_method_call(GDBusConnection *conn,
 		task = rsu_task_host_uri_new(invocation, object, parameters);
 	else if (!strcmp(method, RSU_INTERFACE_REMOVE_FILE))
 		task = rsu_task_remove_uri_new(invocation, object, parameters);
+	else if (!strcmp(method, RSU_INTERFACE_UPDATE_FILE))
+		task = rsu_task_update_uri_new(invocation, object, parameters);
+	else if (!strcmp(method, RSU_INTERFACE_HOST_FD))
+		task = rsu_task_host_fd_new(invocation, object, parameters);
+	else if (!strcmp(method, RSU_INTERFACE_HOST_STREAM))
+		task = rsu_task_host_stream_new(invocation, object,
+						parameters);
+	else if (!strcmp(method, RSU_INTERFACE_HOST_GROWING_FILE))
+		task = rsu_task_host_growing_uri_new(invocation, object,
+						     parameters);
 	else
 		goto on_error;
 
@@ -764,6 +866,7 @@ static void prv_bus_acquired(GDBusConnection *connection, const gchar *name,
 		}
 
 		context->upnp = rsu_upnp_new(connection, info,
+					     context->settings,
 					     prv_found_media_server,
 					     prv_lost_media_server,
 					     user_data);
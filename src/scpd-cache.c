@@ -0,0 +1,271 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "log.h"
+#include "scpd-cache.h"
+
+/* Parsed SCPDs are shared between all renderers of the same model
+   that publish them under the same path, so that a room full of
+   identical devices only downloads and parses each file once.  An
+   entry whose download is still pending has no introspection and
+   collects the requests of every renderer waiting for it. */
+
+typedef struct rsu_scpd_entry_t_ rsu_scpd_entry_t;
+struct rsu_scpd_entry_t_ {
+	rsu_scpd_cache_t *cache;
+	gchar *key;
+	GUPnPServiceIntrospection *introspection;
+	GCancellable *cancellable;
+	GPtrArray *requests;
+};
+
+struct rsu_scpd_request_t_ {
+	rsu_scpd_entry_t *entry;
+	rsu_scpd_cache_cb_t cb;
+	gpointer user_data;
+	guint idle_id;
+};
+
+struct rsu_scpd_cache_t_ {
+	GHashTable *entries;
+};
+
+static void prv_entry_free(gpointer data)
+{
+	rsu_scpd_entry_t *entry = data;
+
+	if (entry->cancellable) {
+		g_cancellable_cancel(entry->cancellable);
+		g_object_unref(entry->cancellable);
+	}
+
+	if (entry->introspection)
+		g_object_unref(entry->introspection);
+
+	g_ptr_array_unref(entry->requests);
+	g_free(entry->key);
+	g_free(entry);
+}
+
+static gchar *prv_make_key(GUPnPDeviceInfo *device_info,
+			   GUPnPServiceInfo *service_info)
+{
+	gchar *manufacturer;
+	gchar *model_name;
+	gchar *model_number;
+	gchar *scpd_url;
+	const gchar *path;
+	gchar *key = NULL;
+
+	scpd_url = gupnp_service_info_get_scpd_url(service_info);
+	if (!scpd_url)
+		goto on_error;
+
+	manufacturer = gupnp_device_info_get_manufacturer(device_info);
+	model_name = gupnp_device_info_get_model_name(device_info);
+	model_number = gupnp_device_info_get_model_number(device_info);
+
+	/* Without a model to go on the file can only be shared with
+	   renderers on the same host */
+
+	path = strstr(scpd_url, "://");
+	if (path)
+		path = strchr(path + 3, '/');
+
+	if (manufacturer && model_name && path)
+		key = g_strdup_printf("%s\n%s\n%s\n%s", manufacturer,
+				      model_name,
+				      model_number ? model_number : "", path);
+	else
+		key = g_strdup(scpd_url);
+
+	g_free(model_number);
+	g_free(model_name);
+	g_free(manufacturer);
+	g_free(scpd_url);
+
+on_error:
+
+	return key;
+}
+
+static void prv_complete_requests(GPtrArray *requests,
+				  GUPnPServiceIntrospection *introspection,
+				  const GError *error)
+{
+	rsu_scpd_request_t *request;
+	unsigned int i;
+
+	for (i = 0; i < requests->len; ++i) {
+		request = g_ptr_array_index(requests, i);
+		request->cb(introspection, error, request->user_data);
+		g_free(request);
+	}
+
+	g_ptr_array_unref(requests);
+}
+
+static void prv_introspection_cb(GUPnPServiceInfo *info,
+				 GUPnPServiceIntrospection *introspection,
+				 const GError *error,
+				 gpointer user_data)
+{
+	rsu_scpd_entry_t *entry = user_data;
+	GPtrArray *requests;
+
+	/* The entry has already been freed if the download was
+	   cancelled */
+
+	if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		goto on_exit;
+
+	g_object_unref(entry->cancellable);
+	entry->cancellable = NULL;
+
+	requests = entry->requests;
+
+	if (error) {
+		RSU_LOG_WARNING("Unable to retrieve SCPD: %s", error->message);
+
+		/* Failures are not cached.  The next renderer to ask
+		   tries again. */
+
+		entry->requests = g_ptr_array_new();
+		g_hash_table_remove(entry->cache->entries, entry->key);
+		prv_complete_requests(requests, NULL, error);
+	} else {
+		RSU_LOG_DEBUG("Parsed SCPD for %u renderer(s)", requests->len);
+
+		entry->introspection = introspection;
+		entry->requests = g_ptr_array_new();
+		prv_complete_requests(requests, introspection, NULL);
+	}
+
+on_exit:
+
+	return;
+}
+
+static gboolean prv_deliver_cb(gpointer user_data)
+{
+	rsu_scpd_request_t *request = user_data;
+	rsu_scpd_entry_t *entry = request->entry;
+
+	(void) g_ptr_array_remove_fast(entry->requests, request);
+	request->cb(entry->introspection, NULL, request->user_data);
+	g_free(request);
+
+	return FALSE;
+}
+
+rsu_scpd_cache_t *rsu_scpd_cache_new(void)
+{
+	rsu_scpd_cache_t *cache = g_new0(rsu_scpd_cache_t, 1);
+
+	cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					       prv_entry_free);
+
+	return cache;
+}
+
+void rsu_scpd_cache_delete(rsu_scpd_cache_t *cache)
+{
+	if (cache) {
+		g_hash_table_unref(cache->entries);
+		g_free(cache);
+	}
+}
+
+rsu_scpd_request_t *rsu_scpd_cache_lookup(rsu_scpd_cache_t *cache,
+					  GUPnPDeviceInfo *device_info,
+					  GUPnPServiceInfo *service_info,
+					  rsu_scpd_cache_cb_t cb,
+					  gpointer user_data)
+{
+	rsu_scpd_entry_t *entry;
+	rsu_scpd_request_t *request = NULL;
+	gchar *key;
+
+	key = prv_make_key(device_info, service_info);
+	if (!key)
+		goto on_error;
+
+	entry = g_hash_table_lookup(cache->entries, key);
+
+	if (!entry) {
+		entry = g_new0(rsu_scpd_entry_t, 1);
+		entry->cache = cache;
+		entry->key = key;
+		entry->requests = g_ptr_array_new();
+		entry->cancellable = g_cancellable_new();
+		g_hash_table_insert(cache->entries, entry->key, entry);
+
+		gupnp_service_info_get_introspection_async_full(
+			service_info, prv_introspection_cb,
+			entry->cancellable, entry);
+	} else {
+		g_free(key);
+	}
+
+	request = g_new0(rsu_scpd_request_t, 1);
+	request->entry = entry;
+	request->cb = cb;
+	request->user_data = user_data;
+	g_ptr_array_add(entry->requests, request);
+
+	if (entry->introspection)
+		request->idle_id = g_idle_add(prv_deliver_cb, request);
+
+on_error:
+
+	return request;
+}
+
+void rsu_scpd_cache_cancel(rsu_scpd_request_t *request)
+{
+	rsu_scpd_entry_t *entry;
+
+	if (!request)
+		goto on_exit;
+
+	entry = request->entry;
+
+	if (request->idle_id)
+		(void) g_source_remove(request->idle_id);
+
+	(void) g_ptr_array_remove_fast(entry->requests, request);
+	g_free(request);
+
+	/* Nobody else is waiting for this file so there is no point in
+	   continuing to download it */
+
+	if (!entry->introspection && entry->requests->len == 0)
+		g_hash_table_remove(entry->cache->entries, entry->key);
+
+on_exit:
+
+	return;
+}
@@ -0,0 +1,53 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+#ifndef RSU_SCPD_CACHE_H__
+#define RSU_SCPD_CACHE_H__
+
+#include <glib.h>
+#include <libgupnp/gupnp-control-point.h>
+
+typedef struct rsu_scpd_cache_t_ rsu_scpd_cache_t;
+typedef struct rsu_scpd_request_t_ rsu_scpd_request_t;
+
+/* introspection is owned by the cache and is NULL if error is set */
+
+typedef void (*rsu_scpd_cache_cb_t)(
+	GUPnPServiceIntrospection *introspection, const GError *error,
+	gpointer user_data);
+
+rsu_scpd_cache_t *rsu_scpd_cache_new(void);
+void rsu_scpd_cache_delete(rsu_scpd_cache_t *cache);
+
+/* The callback is always invoked from the main loop, never from
+   within rsu_scpd_cache_lookup.  A request that is cancelled before
+   then is freed and its callback is not invoked. */
+
+rsu_scpd_request_t *rsu_scpd_cache_lookup(rsu_scpd_cache_t *cache,
+					  GUPnPDeviceInfo *device_info,
+					  GUPnPServiceInfo *service_info,
+					  rsu_scpd_cache_cb_t cb,
+					  gpointer user_data);
+void rsu_scpd_cache_cancel(rsu_scpd_request_t *request);
+
+#endif
@@ -33,6 +33,17 @@ struct rsu_settings_context_t_ {
 	/* Global section */
 	gboolean never_quit;
 
+	/* UPnP section */
+	gboolean lazy_subscription;
+	guint subscription_idle_timeout;
+	guint subscription_window;
+	gboolean sync_on_discovery;
+
+	/* Host section */
+	guint mapping_budget;
+	gboolean shared_listener;
+	gboolean drop_slow_readers;
+
 	/* Log section */
 	rsu_log_type_t log_type;
 	int log_level;
@@ -43,14 +54,36 @@ struct rsu_settings_context_t_ {
 #define RSU_SETTINGS_GROUP_GENERAL	"general"
 #define RSU_SETTINGS_KEY_NEVER_QUIT	"never-quit"
 
+#define RSU_SETTINGS_GROUP_UPNP		"upnp"
+#define RSU_SETTINGS_KEY_LAZY_SUBSCRIPTION	"lazy-subscription"
+#define RSU_SETTINGS_KEY_SUBSCRIPTION_IDLE_TIMEOUT \
+	"subscription-idle-timeout"
+#define RSU_SETTINGS_KEY_SUBSCRIPTION_WINDOW	"subscription-window"
+#define RSU_SETTINGS_KEY_SYNC_ON_DISCOVERY	"sync-on-discovery"
+
+#define RSU_SETTINGS_GROUP_HOST		"host"
+#define RSU_SETTINGS_KEY_MAPPING_BUDGET	"mapping-budget"
+#define RSU_SETTINGS_KEY_SHARED_LISTENER	"shared-listener"
+#define RSU_SETTINGS_KEY_DROP_SLOW_READERS	"drop-slow-readers"
+
 #define RSU_SETTINGS_GROUP_LOG		"log"
 #define RSU_SETTINGS_KEY_LOG_TYPE	"log-type"
 #define RSU_SETTINGS_KEY_LOG_LEVEL	"log-level"
 
 #define RSU_SETTINGS_DEFAULT_NEVER_QUIT	RSU_NEVER_QUIT
+#define RSU_SETTINGS_DEFAULT_LAZY_SUBSCRIPTION	FALSE
+#define RSU_SETTINGS_DEFAULT_SUBSCRIPTION_IDLE_TIMEOUT	300
+#define RSU_SETTINGS_DEFAULT_SUBSCRIPTION_WINDOW	0
+#define RSU_SETTINGS_DEFAULT_SYNC_ON_DISCOVERY	FALSE
+#define RSU_SETTINGS_DEFAULT_MAPPING_BUDGET	256
+#define RSU_SETTINGS_DEFAULT_SHARED_LISTENER	FALSE
+#define RSU_SETTINGS_DEFAULT_DROP_SLOW_READERS	FALSE
 #define RSU_SETTINGS_DEFAULT_LOG_TYPE	RSU_LOG_TYPE
 #define RSU_SETTINGS_DEFAULT_LOG_LEVEL	RSU_LOG_LEVEL
 
+/* Longer windows are clamped to this many seconds */
+#define RSU_SETTINGS_MAX_SUBSCRIPTION_WINDOW	3600
+
 #define RSU_SETTINGS_LOG_KEYS(sys, loc, settings) \
 do { \
        RSU_LOG_DEBUG_NL(); \
@@ -59,6 +92,23 @@ do { \
        RSU_LOG_DEBUG("[General settings]"); \
        RSU_LOG_DEBUG("Never Quit: %s", (settings)->never_quit ? "T" : "F"); \
        RSU_LOG_DEBUG_NL(); \
+       RSU_LOG_DEBUG("[UPnP settings]"); \
+       RSU_LOG_DEBUG("Lazy Subscription: %s", \
+		     (settings)->lazy_subscription ? "T" : "F"); \
+       RSU_LOG_DEBUG("Subscription Idle Timeout: %u", \
+		     (settings)->subscription_idle_timeout); \
+       RSU_LOG_DEBUG("Subscription Window: %u", \
+		     (settings)->subscription_window); \
+       RSU_LOG_DEBUG("Sync On Discovery: %s", \
+		     (settings)->sync_on_discovery ? "T" : "F"); \
+       RSU_LOG_DEBUG_NL(); \
+       RSU_LOG_DEBUG("[Host settings]"); \
+       RSU_LOG_DEBUG("Mapping Budget: %u MiB", (settings)->mapping_budget); \
+       RSU_LOG_DEBUG("Shared Listener: %s", \
+		     (settings)->shared_listener ? "T" : "F"); \
+       RSU_LOG_DEBUG("Drop Slow Readers: %s", \
+		     (settings)->drop_slow_readers ? "T" : "F"); \
+       RSU_LOG_DEBUG_NL(); \
        RSU_LOG_DEBUG("[Logging settings]"); \
        RSU_LOG_DEBUG("Log Type : %d", (settings)->log_type); \
        RSU_LOG_DEBUG("Log Level: 0x%02X", (settings)->log_level); \
@@ -195,6 +245,87 @@ static void prv_rsu_settings_read_keys(rsu_settings_context_t *settings)
 		error = NULL;
 	}
 
+	b_val = g_key_file_get_boolean(keyfile, RSU_SETTINGS_GROUP_UPNP,
+				RSU_SETTINGS_KEY_LAZY_SUBSCRIPTION,
+				&error);
+
+	if (error == NULL)
+		settings->lazy_subscription = b_val;
+	else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	int_val = g_key_file_get_integer(keyfile, RSU_SETTINGS_GROUP_UPNP,
+				RSU_SETTINGS_KEY_SUBSCRIPTION_IDLE_TIMEOUT,
+				&error);
+
+	if (error == NULL) {
+		if (int_val > 0)
+			settings->subscription_idle_timeout = int_val;
+	} else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	int_val = g_key_file_get_integer(keyfile, RSU_SETTINGS_GROUP_UPNP,
+				RSU_SETTINGS_KEY_SUBSCRIPTION_WINDOW,
+				&error);
+
+	if (error == NULL) {
+		if (int_val >= 0)
+			settings->subscription_window = MIN(
+				int_val, RSU_SETTINGS_MAX_SUBSCRIPTION_WINDOW);
+	} else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	b_val = g_key_file_get_boolean(keyfile, RSU_SETTINGS_GROUP_UPNP,
+				RSU_SETTINGS_KEY_SYNC_ON_DISCOVERY,
+				&error);
+
+	if (error == NULL)
+		settings->sync_on_discovery = b_val;
+	else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	int_val = g_key_file_get_integer(keyfile, RSU_SETTINGS_GROUP_HOST,
+				RSU_SETTINGS_KEY_MAPPING_BUDGET,
+				&error);
+
+	if (error == NULL) {
+		if (int_val >= 0)
+			settings->mapping_budget = int_val;
+	} else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	b_val = g_key_file_get_boolean(keyfile, RSU_SETTINGS_GROUP_HOST,
+				RSU_SETTINGS_KEY_SHARED_LISTENER,
+				&error);
+
+	if (error == NULL)
+		settings->shared_listener = b_val;
+	else {
+		g_error_free(error);
+		error = NULL;
+	}
+
+	b_val = g_key_file_get_boolean(keyfile, RSU_SETTINGS_GROUP_HOST,
+				RSU_SETTINGS_KEY_DROP_SLOW_READERS,
+				&error);
+
+	if (error == NULL)
+		settings->drop_slow_readers = b_val;
+	else {
+		g_error_free(error);
+		error = NULL;
+	}
+
 	int_val = g_key_file_get_integer(keyfile, RSU_SETTINGS_GROUP_LOG,
 						  RSU_SETTINGS_KEY_LOG_TYPE,
 						  &error);
@@ -227,6 +358,17 @@ static void prv_rsu_settings_init_default(rsu_settings_context_t *settings)
 {
 	settings->never_quit = RSU_SETTINGS_DEFAULT_NEVER_QUIT;
 
+	settings->lazy_subscription = RSU_SETTINGS_DEFAULT_LAZY_SUBSCRIPTION;
+	settings->subscription_idle_timeout =
+		RSU_SETTINGS_DEFAULT_SUBSCRIPTION_IDLE_TIMEOUT;
+	settings->subscription_window =
+		RSU_SETTINGS_DEFAULT_SUBSCRIPTION_WINDOW;
+	settings->sync_on_discovery = RSU_SETTINGS_DEFAULT_SYNC_ON_DISCOVERY;
+
+	settings->mapping_budget = RSU_SETTINGS_DEFAULT_MAPPING_BUDGET;
+	settings->shared_listener = RSU_SETTINGS_DEFAULT_SHARED_LISTENER;
+	settings->drop_slow_readers = RSU_SETTINGS_DEFAULT_DROP_SLOW_READERS;
+
 	settings->log_type = RSU_SETTINGS_DEFAULT_LOG_TYPE;
 	settings->log_level = RSU_SETTINGS_DEFAULT_LOG_LEVEL;
 }
@@ -341,6 +483,42 @@ gboolean rsu_settings_is_never_quit(rsu_settings_context_t *settings)
 	return settings->never_quit;
 }
 
+gboolean rsu_settings_is_lazy_subscription(rsu_settings_context_t *settings)
+{
+	return settings->lazy_subscription;
+}
+
+guint rsu_settings_get_subscription_idle_timeout(
+	rsu_settings_context_t *settings)
+{
+	return settings->subscription_idle_timeout;
+}
+
+guint rsu_settings_get_subscription_window(rsu_settings_context_t *settings)
+{
+	return settings->subscription_window;
+}
+
+gboolean rsu_settings_is_sync_on_discovery(rsu_settings_context_t *settings)
+{
+	return settings->sync_on_discovery;
+}
+
+guint rsu_settings_get_mapping_budget(rsu_settings_context_t *settings)
+{
+	return settings->mapping_budget;
+}
+
+gboolean rsu_settings_is_shared_listener(rsu_settings_context_t *settings)
+{
+	return settings->shared_listener;
+}
+
+gboolean rsu_settings_is_drop_slow_readers(rsu_settings_context_t *settings)
+{
+	return settings->drop_slow_readers;
+}
+
 void rsu_settings_new(rsu_settings_context_t **settings)
 {
 	gchar *sys_path = NULL;
@@ -35,4 +35,14 @@ void rsu_settings_delete(rsu_settings_context_t *settings);
 
 gboolean rsu_settings_is_never_quit(rsu_settings_context_t *settings);
 
+gboolean rsu_settings_is_lazy_subscription(rsu_settings_context_t *settings);
+guint rsu_settings_get_subscription_idle_timeout(
+	rsu_settings_context_t *settings);
+guint rsu_settings_get_subscription_window(rsu_settings_context_t *settings);
+gboolean rsu_settings_is_sync_on_discovery(rsu_settings_context_t *settings);
+
+guint rsu_settings_get_mapping_budget(rsu_settings_context_t *settings);
+gboolean rsu_settings_is_shared_listener(rsu_settings_context_t *settings);
+gboolean rsu_settings_is_drop_slow_readers(rsu_settings_context_t *settings);
+
 #endif /* RSU_SETTINGS_H__ */
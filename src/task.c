@@ -21,6 +21,9 @@
  */
 
 
+#include <unistd.h>
+#include <gio/gunixfdlist.h>
+
 #include "error.h"
 #include "task.h"
 
@@ -49,6 +52,23 @@ rsu_task_t *rsu_task_get_servers_new(GDBusMethodInvocation *invocation)
 	return task;
 }
 
+rsu_task_t *rsu_task_get_compatible_servers_new(
+	GDBusMethodInvocation *invocation, GVariant *parameters)
+{
+	rsu_task_t *task = g_new0(rsu_task_t, 1);
+
+	task->type = RSU_TASK_GET_COMPATIBLE_SERVERS;
+	task->invocation = invocation;
+	task->result_format = "(@as)";
+	task->synchronous = TRUE;
+
+	g_variant_get(parameters, "(s)",
+		      &task->ut.get_compatible_servers.protocol_info);
+	g_strstrip(task->ut.get_compatible_servers.protocol_info);
+
+	return task;
+}
+
 rsu_task_t *rsu_task_raise_new(GDBusMethodInvocation *invocation)
 {
 	rsu_task_t *task = g_new0(rsu_task_t, 1);
@@ -74,6 +94,9 @@ rsu_task_t *rsu_task_quit_new(GDBusMethodInvocation *invocation)
 static void prv_rsu_task_delete(rsu_task_t *task)
 {
 	switch (task->type) {
+	case RSU_TASK_GET_COMPATIBLE_SERVERS:
+		g_free(task->ut.get_compatible_servers.protocol_info);
+		break;
 	case RSU_TASK_GET_ALL_PROPS:
 		g_free(task->ut.get_props.interface_name);
 		break;
@@ -81,14 +104,28 @@ static void prv_rsu_task_delete(rsu_task_t *task)
 		g_free(task->ut.get_prop.interface_name);
 		g_free(task->ut.get_prop.prop_name);
 		break;
+	case RSU_TASK_SET_PROP:
+		g_free(task->ut.set_prop.interface_name);
+		g_free(task->ut.set_prop.prop_name);
+		g_variant_unref(task->ut.set_prop.params);
+		break;
 	case RSU_TASK_OPEN_URI:
 		g_free(task->ut.open_uri.uri);
 		break;
 	case RSU_TASK_HOST_URI:
+	case RSU_TASK_HOST_GROWING_URI:
 	case RSU_TASK_REMOVE_URI:
+	case RSU_TASK_UPDATE_URI:
 		g_free(task->ut.host_uri.uri);
 		g_free(task->ut.host_uri.client);
 		break;
+	case RSU_TASK_HOST_FD:
+	case RSU_TASK_HOST_STREAM:
+		if (task->ut.host_fd.fd >= 0)
+			(void) close(task->ut.host_fd.fd);
+		g_free(task->ut.host_fd.mime_type);
+		g_free(task->ut.host_fd.client);
+		break;
 	default:
 		break;
 	}
@@ -147,6 +184,22 @@ rsu_task_t *rsu_task_get_props_new(GDBusMethodInvocation *invocation,
 	return task;
 }
 
+rsu_task_t *rsu_task_set_prop_new(GDBusMethodInvocation *invocation,
+				  const gchar *path, GVariant *parameters)
+{
+	rsu_task_t *task;
+
+	task = prv_device_task_new(RSU_TASK_SET_PROP, invocation, path, NULL);
+
+	g_variant_get(parameters, "(ssv)", &task->ut.set_prop.interface_name,
+		      &task->ut.set_prop.prop_name, &task->ut.set_prop.params);
+
+	g_strstrip(task->ut.set_prop.interface_name);
+	g_strstrip(task->ut.set_prop.prop_name);
+
+	return task;
+}
+
 rsu_task_t *rsu_task_play_new(GDBusMethodInvocation *invocation,
 			      const gchar *path)
 {
@@ -221,14 +274,46 @@ rsu_task_t *rsu_task_open_uri_new(GDBusMethodInvocation *invocation,
 	return task;
 }
 
+static rsu_task_t *prv_host_uri_task_new(rsu_task_type_t type,
+					 GDBusMethodInvocation *invocation,
+					 const gchar *path,
+					 GVariant *parameters)
+{
+	rsu_task_t *task;
+
+	task = prv_device_task_new(type, invocation, path, "(@s)");
+
+	g_variant_get(parameters, "(s)", &task->ut.host_uri.uri);
+	g_strstrip(task->ut.host_uri.uri);
+	task->ut.host_uri.client = g_strdup(
+		g_dbus_method_invocation_get_sender(invocation));
+
+	return task;
+}
+
 rsu_task_t *rsu_task_host_uri_new(GDBusMethodInvocation *invocation,
 				  const gchar *path,
 				  GVariant *parameters)
+{
+	return prv_host_uri_task_new(RSU_TASK_HOST_URI, invocation, path,
+				     parameters);
+}
+
+rsu_task_t *rsu_task_host_growing_uri_new(GDBusMethodInvocation *invocation,
+					  const gchar *path,
+					  GVariant *parameters)
+{
+	return prv_host_uri_task_new(RSU_TASK_HOST_GROWING_URI, invocation,
+				     path, parameters);
+}
+
+rsu_task_t *rsu_task_remove_uri_new(GDBusMethodInvocation *invocation,
+				    const gchar *path,
+				    GVariant *parameters)
 {
 	rsu_task_t *task;
 
-	task = prv_device_task_new(RSU_TASK_HOST_URI, invocation, path,
-				   "(@s)");
+	task = prv_device_task_new(RSU_TASK_REMOVE_URI, invocation, path, NULL);
 
 	g_variant_get(parameters, "(s)", &task->ut.host_uri.uri);
 	g_strstrip(task->ut.host_uri.uri);
@@ -238,13 +323,14 @@ rsu_task_t *rsu_task_host_uri_new(GDBusMethodInvocation *invocation,
 	return task;
 }
 
-rsu_task_t *rsu_task_remove_uri_new(GDBusMethodInvocation *invocation,
+rsu_task_t *rsu_task_update_uri_new(GDBusMethodInvocation *invocation,
 				    const gchar *path,
 				    GVariant *parameters)
 {
 	rsu_task_t *task;
 
-	task = prv_device_task_new(RSU_TASK_REMOVE_URI, invocation, path, NULL);
+	task = prv_device_task_new(RSU_TASK_UPDATE_URI, invocation, path,
+				   "(@s)");
 
 	g_variant_get(parameters, "(s)", &task->ut.host_uri.uri);
 	g_strstrip(task->ut.host_uri.uri);
@@ -254,6 +340,55 @@ rsu_task_t *rsu_task_remove_uri_new(GDBusMethodInvocation *invocation,
 	return task;
 }
 
+static rsu_task_t *prv_host_fd_task_new(rsu_task_type_t type,
+					GDBusMethodInvocation *invocation,
+					const gchar *path,
+					GVariant *parameters)
+{
+	rsu_task_t *task;
+	GDBusMessage *message;
+	GUnixFDList *fd_list;
+	gint32 handle;
+
+	task = prv_device_task_new(type, invocation, path, "(@s)");
+
+	g_variant_get(parameters, "(hs)", &handle,
+		      &task->ut.host_fd.mime_type);
+	g_strstrip(task->ut.host_fd.mime_type);
+	task->ut.host_fd.client = g_strdup(
+		g_dbus_method_invocation_get_sender(invocation));
+
+	/* The descriptor is duplicated so that it outlives the message.
+	   It is left at -1 if the handle does not refer to one. */
+
+	task->ut.host_fd.fd = -1;
+	message = g_dbus_method_invocation_get_message(invocation);
+	fd_list = g_dbus_message_get_unix_fd_list(message);
+
+	if (fd_list && handle >= 0 &&
+	    handle < g_unix_fd_list_get_length(fd_list))
+		task->ut.host_fd.fd = g_unix_fd_list_get(fd_list, handle,
+							 NULL);
+
+	return task;
+}
+
+rsu_task_t *rsu_task_host_fd_new(GDBusMethodInvocation *invocation,
+				 const gchar *path,
+				 GVariant *parameters)
+{
+	return prv_host_fd_task_new(RSU_TASK_HOST_FD, invocation, path,
+				    parameters);
+}
+
+rsu_task_t *rsu_task_host_stream_new(GDBusMethodInvocation *invocation,
+				     const gchar *path,
+				     GVariant *parameters)
+{
+	return prv_host_fd_task_new(RSU_TASK_HOST_STREAM, invocation, path,
+				    parameters);
+}
+
 void rsu_task_complete_and_delete(rsu_task_t *task)
 {
 	if (!task)
@@ -29,10 +29,12 @@
 enum rsu_task_type_t_ {
 	RSU_TASK_GET_VERSION,
 	RSU_TASK_GET_SERVERS,
+	RSU_TASK_GET_COMPATIBLE_SERVERS,
 	RSU_TASK_RAISE,
 	RSU_TASK_QUIT,
 	RSU_TASK_GET_ALL_PROPS,
 	RSU_TASK_GET_PROP,
+	RSU_TASK_SET_PROP,
 	RSU_TASK_PAUSE,
 	RSU_TASK_PLAY,
 	RSU_TASK_PLAY_PAUSE,
@@ -43,12 +45,22 @@ enum rsu_task_type_t_ {
 	RSU_TASK_SEEK,
 	RSU_TASK_SET_POSITION,
 	RSU_TASK_HOST_URI,
-	RSU_TASK_REMOVE_URI
+	RSU_TASK_REMOVE_URI,
+	RSU_TASK_UPDATE_URI,
+	RSU_TASK_HOST_FD,
+	RSU_TASK_HOST_STREAM,
+	RSU_TASK_HOST_GROWING_URI
 };
 typedef enum rsu_task_type_t_ rsu_task_type_t;
 
 typedef void (*rsu_cancel_task_t)(void *handle);
 
+typedef struct rsu_task_get_compatible_servers_t_
+rsu_task_get_compatible_servers_t;
+struct rsu_task_get_compatible_servers_t_ {
+	gchar *protocol_info;
+};
+
 typedef struct rsu_task_get_props_t_ rsu_task_get_props_t;
 struct rsu_task_get_props_t_ {
 	gchar *interface_name;
@@ -60,6 +72,13 @@ struct rsu_task_get_prop_t_ {
 	gchar *interface_name;
 };
 
+typedef struct rsu_task_set_prop_t_ rsu_task_set_prop_t;
+struct rsu_task_set_prop_t_ {
+	gchar *prop_name;
+	gchar *interface_name;
+	GVariant *params;
+};
+
 typedef struct rsu_task_open_uri_t_ rsu_task_open_uri_t;
 struct rsu_task_open_uri_t_ {
 	gchar *uri;
@@ -76,6 +95,13 @@ struct rsu_task_host_uri_t_ {
 	gchar *client;
 };
 
+typedef struct rsu_task_host_fd_t_ rsu_task_host_fd_t;
+struct rsu_task_host_fd_t_ {
+	int fd;
+	gchar *mime_type;
+	gchar *client;
+};
+
 typedef struct rsu_task_t_ rsu_task_t;
 struct rsu_task_t_ {
 	rsu_task_type_t type;
@@ -85,22 +111,29 @@ struct rsu_task_t_ {
 	GDBusMethodInvocation *invocation;
 	gboolean synchronous;
 	union {
+		rsu_task_get_compatible_servers_t get_compatible_servers;
 		rsu_task_get_props_t get_props;
 		rsu_task_get_prop_t get_prop;
+		rsu_task_set_prop_t set_prop;
 		rsu_task_open_uri_t open_uri;
 		rsu_task_host_uri_t host_uri;
+		rsu_task_host_fd_t host_fd;
 		rsu_task_seek_t seek;
 	} ut;
 };
 
 rsu_task_t *rsu_task_get_version_new(GDBusMethodInvocation *invocation);
 rsu_task_t *rsu_task_get_servers_new(GDBusMethodInvocation *invocation);
+rsu_task_t *rsu_task_get_compatible_servers_new(
+	GDBusMethodInvocation *invocation, GVariant *parameters);
 rsu_task_t *rsu_task_raise_new(GDBusMethodInvocation *invocation);
 rsu_task_t *rsu_task_quit_new(GDBusMethodInvocation *invocation);
 rsu_task_t *rsu_task_get_prop_new(GDBusMethodInvocation *invocation,
 				  const gchar *path, GVariant *parameters);
 rsu_task_t *rsu_task_get_props_new(GDBusMethodInvocation *invocation,
 				   const gchar *path, GVariant *parameters);
+rsu_task_t *rsu_task_set_prop_new(GDBusMethodInvocation *invocation,
+				  const gchar *path, GVariant *parameters);
 rsu_task_t *rsu_task_play_new(GDBusMethodInvocation *invocation,
 			      const gchar *path);
 rsu_task_t *rsu_task_pause_new(GDBusMethodInvocation *invocation,
@@ -123,6 +156,15 @@ rsu_task_t *rsu_task_host_uri_new(GDBusMethodInvocation *invocation,
 				  const gchar *path, GVariant *parameters);
 rsu_task_t *rsu_task_remove_uri_new(GDBusMethodInvocation *invocation,
 				    const gchar *path, GVariant *parameters);
+rsu_task_t *rsu_task_update_uri_new(GDBusMethodInvocation *invocation,
+				    const gchar *path, GVariant *parameters);
+rsu_task_t *rsu_task_host_fd_new(GDBusMethodInvocation *invocation,
+				 const gchar *path, GVariant *parameters);
+rsu_task_t *rsu_task_host_stream_new(GDBusMethodInvocation *invocation,
+				     const gchar *path, GVariant *parameters);
+rsu_task_t *rsu_task_host_growing_uri_new(GDBusMethodInvocation *invocation,
+					  const gchar *path,
+					  GVariant *parameters);
 void rsu_task_complete_and_delete(rsu_task_t *task);
 void rsu_task_fail_and_delete(rsu_task_t *task, GError *error);
 void rsu_task_delete(rsu_task_t *task);
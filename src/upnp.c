@@ -27,9 +27,12 @@
 
 #include "async.h"
 #include "device.h"
+#include "device-cache.h"
 #include "error.h"
 #include "host-service.h"
 #include "prop-defs.h"
+#include "protocol-info.h"
+#include "scpd-cache.h"
 #include "upnp.h"
 
 struct rsu_upnp_t_ {
@@ -42,8 +45,58 @@ struct rsu_upnp_t_ {
 	GHashTable *server_udn_map;
 	guint counter;
 	rsu_host_service_t *host_service;
+	rsu_protocol_info_index_t *protocol_info_index;
+	rsu_device_cache_t *device_cache;
+	rsu_scpd_cache_t *scpd_cache;
+	rsu_settings_context_t *settings;
 };
 
+static void prv_save_device(rsu_upnp_t *upnp, const gchar *udn,
+			    rsu_device_t *device)
+{
+	rsu_device_context_t *context;
+	const gchar *location;
+	GVariant *root_props;
+	GVariant *player_props;
+
+	context = rsu_device_get_context(device);
+	location = gupnp_device_info_get_location(
+		(GUPnPDeviceInfo *) context->device_proxy);
+
+	rsu_device_save_props(device, &root_props, &player_props);
+	rsu_device_cache_update(upnp->device_cache, udn, location,
+				root_props, player_props);
+}
+
+static void prv_refresh_device_cache(gpointer user_data)
+{
+	rsu_upnp_t *upnp = user_data;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, upnp->server_udn_map);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		prv_save_device(upnp, key, value);
+}
+
+static void prv_restore_device(rsu_upnp_t *upnp, const gchar *udn,
+			       GUPnPDeviceProxy *proxy, rsu_device_t *device)
+{
+	const gchar *location;
+	GVariant *root_props;
+	GVariant *player_props;
+
+	location = gupnp_device_info_get_location((GUPnPDeviceInfo *) proxy);
+
+	if (rsu_device_cache_lookup(upnp->device_cache, udn, location,
+				    &root_props, &player_props)) {
+		rsu_device_restore_props(device, root_props, player_props);
+		g_variant_unref(player_props);
+		g_variant_unref(root_props);
+	}
+}
+
 static void prv_server_available_cb(GUPnPControlPoint *cp,
 				    GUPnPDeviceProxy *proxy,
 				    gpointer user_data)
@@ -69,11 +122,19 @@ static void prv_server_available_cb(GUPnPControlPoint *cp,
 				   ip_address,
 				   upnp->counter,
 				   upnp->interface_info,
+				   upnp->protocol_info_index,
+				   upnp->scpd_cache,
+				   upnp->device_cache,
+				   upnp->settings,
 				   upnp->user_data,
 				   &device)) {
 			++upnp->counter;
+			prv_restore_device(upnp, udn, proxy, device);
 			g_hash_table_insert(upnp->server_udn_map, g_strdup(udn),
 					    device);
+
+			if (rsu_settings_is_sync_on_discovery(upnp->settings))
+				rsu_device_sync(device);
 			upnp->found_server(device->path, upnp->user_data);
 		}
 	} else {
@@ -124,6 +185,9 @@ static void prv_server_unavailable_cb(GUPnPControlPoint *cp,
 	}
 
 	if (i < device->contexts->len) {
+		if (device->contexts->len == 1)
+			prv_save_device(upnp, udn, device);
+
 		(void) g_ptr_array_remove_index(device->contexts, i);
 
 		if (device->contexts->len == 0) {
@@ -165,6 +229,7 @@ static void prv_on_context_available(GUPnPContextManager *context_manager,
 
 rsu_upnp_t *rsu_upnp_new(GDBusConnection *connection,
 			 rsu_interface_info_t *interface_info,
+			 rsu_settings_context_t *settings,
 			 rsu_upnp_callback_t found_server,
 			 rsu_upnp_callback_t lost_server,
 			 void *user_data)
@@ -173,9 +238,14 @@ rsu_upnp_t *rsu_upnp_new(GDBusConnection *connection,
 
 	upnp->connection = connection;
 	upnp->interface_info = interface_info;
+	upnp->settings = settings;
 	upnp->user_data = user_data;
 	upnp->found_server = found_server;
 	upnp->lost_server = lost_server;
+	upnp->protocol_info_index = rsu_protocol_info_index_new();
+	upnp->device_cache = rsu_device_cache_new(prv_refresh_device_cache,
+						  upnp);
+	upnp->scpd_cache = rsu_scpd_cache_new();
 
 	upnp->server_udn_map = g_hash_table_new_full(g_str_hash, g_str_equal,
 						     g_free,
@@ -186,7 +256,7 @@ rsu_upnp_t *rsu_upnp_new(GDBusConnection *connection,
 			 G_CALLBACK(prv_on_context_available),
 			 upnp);
 
-	rsu_host_service_new(&upnp->host_service);
+	rsu_host_service_new(upnp->settings, &upnp->host_service);
 
 	return upnp;
 }
@@ -194,9 +264,14 @@ rsu_upnp_t *rsu_upnp_new(GDBusConnection *connection,
 void rsu_upnp_delete(rsu_upnp_t *upnp)
 {
 	if (upnp) {
+		prv_refresh_device_cache(upnp);
+
 		rsu_host_service_delete(upnp->host_service);
 		g_object_unref(upnp->context_manager);
 		g_hash_table_unref(upnp->server_udn_map);
+		rsu_protocol_info_index_delete(upnp->protocol_info_index);
+		rsu_device_cache_delete(upnp->device_cache);
+		rsu_scpd_cache_delete(upnp->scpd_cache);
 
 		g_free(upnp->interface_info);
 		g_free(upnp);
@@ -221,6 +296,25 @@ GVariant *rsu_upnp_get_server_ids(rsu_upnp_t *upnp)
 	return g_variant_ref_sink(g_variant_builder_end(&vb));
 }
 
+GVariant *rsu_upnp_get_compatible_server_ids(rsu_upnp_t *upnp,
+					     const gchar *protocol_info,
+					     GError **error)
+{
+	return rsu_protocol_info_index_lookup(upnp->protocol_info_index,
+					      protocol_info, error);
+}
+
+static rsu_device_t *prv_get_device(rsu_upnp_t *upnp, const gchar *path)
+{
+	rsu_device_t *device;
+
+	device = rsu_device_from_path(path, upnp->server_udn_map);
+	if (device)
+		rsu_device_touch(device);
+
+	return device;
+}
+
 void rsu_upnp_get_prop(rsu_upnp_t *upnp, rsu_task_t *task,
 		       GCancellable *cancellable,
 		       rsu_upnp_task_complete_t cb,
@@ -229,7 +323,7 @@ void rsu_upnp_get_prop(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -253,7 +347,7 @@ void rsu_upnp_get_all_props(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -270,6 +364,30 @@ void rsu_upnp_get_all_props(rsu_upnp_t *upnp, rsu_task_t *task,
 	}
 }
 
+void rsu_upnp_set_prop(rsu_upnp_t *upnp, rsu_task_t *task,
+		       GCancellable *cancellable,
+		       rsu_upnp_task_complete_t cb,
+		       void *user_data)
+{
+	rsu_device_t *device;
+	rsu_async_cb_data_t *cb_data;
+
+	device = prv_get_device(upnp, task->path);
+
+	if (!device) {
+		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+						NULL);
+		cb_data->error = g_error_new(RSU_ERROR,
+					     RSU_ERROR_OBJECT_NOT_FOUND,
+					     "Cannot locate a device"
+					     " for the specified "
+					     "object");
+		(void) g_idle_add(rsu_async_complete_task, cb_data);
+	} else {
+		rsu_device_set_prop(device, task, cancellable, cb, user_data);
+	}
+}
+
 void rsu_upnp_play(rsu_upnp_t *upnp, rsu_task_t *task,
 		   GCancellable *cancellable,
 		   rsu_upnp_task_complete_t cb,
@@ -278,7 +396,7 @@ void rsu_upnp_play(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -303,7 +421,7 @@ void rsu_upnp_pause(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -328,7 +446,7 @@ void rsu_upnp_play_pause(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -353,7 +471,7 @@ void rsu_upnp_stop(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -378,7 +496,7 @@ void rsu_upnp_next(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -403,7 +521,7 @@ void rsu_upnp_previous(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -428,7 +546,7 @@ void rsu_upnp_open_uri(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -453,7 +571,7 @@ void rsu_upnp_seek(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -477,7 +595,7 @@ void rsu_upnp_set_position(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -502,7 +620,7 @@ void rsu_upnp_host_uri(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -527,7 +645,7 @@ void rsu_upnp_remove_uri(rsu_upnp_t *upnp, rsu_task_t *task,
 	rsu_device_t *device;
 	rsu_async_cb_data_t *cb_data;
 
-	device = rsu_device_from_path(task->path, upnp->server_udn_map);
+	device = prv_get_device(upnp, task->path);
 
 	if (!device) {
 		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
@@ -544,6 +662,56 @@ void rsu_upnp_remove_uri(rsu_upnp_t *upnp, rsu_task_t *task,
 	}
 }
 
+void rsu_upnp_update_uri(rsu_upnp_t *upnp, rsu_task_t *task,
+			 GCancellable *cancellable,
+			 rsu_upnp_task_complete_t cb,
+			 void *user_data)
+{
+	rsu_device_t *device;
+	rsu_async_cb_data_t *cb_data;
+
+	device = prv_get_device(upnp, task->path);
+
+	if (!device) {
+		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+						NULL);
+		cb_data->error = g_error_new(RSU_ERROR,
+					     RSU_ERROR_OBJECT_NOT_FOUND,
+					     "Cannot locate a device"
+					     " for the specified "
+					     "object");
+		(void) g_idle_add(rsu_async_complete_task, cb_data);
+	} else {
+		rsu_device_update_uri(device, task, upnp->host_service,
+				      cancellable, cb, user_data);
+	}
+}
+
+void rsu_upnp_host_fd(rsu_upnp_t *upnp, rsu_task_t *task,
+		      GCancellable *cancellable,
+		      rsu_upnp_task_complete_t cb,
+		      void *user_data)
+{
+	rsu_device_t *device;
+	rsu_async_cb_data_t *cb_data;
+
+	device = prv_get_device(upnp, task->path);
+
+	if (!device) {
+		cb_data = rsu_async_cb_data_new(task, cb, user_data, NULL, NULL,
+						NULL);
+		cb_data->error = g_error_new(RSU_ERROR,
+					     RSU_ERROR_OBJECT_NOT_FOUND,
+					     "Cannot locate a device"
+					     " for the specified "
+					     "object");
+		(void) g_idle_add(rsu_async_complete_task, cb_data);
+	} else {
+		rsu_device_host_fd(device, task, upnp->host_service,
+				   cancellable, cb, user_data);
+	}
+}
+
 void rsu_upnp_lost_client(rsu_upnp_t *upnp, const gchar *client_name)
 {
 	rsu_host_service_lost_client(upnp->host_service, client_name);
@@ -23,6 +23,7 @@
 #ifndef RSU_UPNP_H__
 #define RSU_UPNP_H__
 
+#include "settings.h"
 #include "task.h"
 
 typedef struct rsu_upnp_t_ rsu_upnp_t;
@@ -47,11 +48,15 @@ typedef void (*rsu_upnp_task_complete_t)(rsu_task_t *task, GVariant *result,
 
 rsu_upnp_t *rsu_upnp_new(GDBusConnection *connection,
 			 rsu_interface_info_t *interface_info,
+			 rsu_settings_context_t *settings,
 			 rsu_upnp_callback_t found_server,
 			 rsu_upnp_callback_t lost_server,
 			 void *user_data);
 void rsu_upnp_delete(rsu_upnp_t *upnp);
 GVariant *rsu_upnp_get_server_ids(rsu_upnp_t *upnp);
+GVariant *rsu_upnp_get_compatible_server_ids(rsu_upnp_t *upnp,
+					     const gchar *protocol_info,
+					     GError **error);
 void rsu_upnp_get_prop(rsu_upnp_t *upnp, rsu_task_t *task,
 		       GCancellable *cancellable,
 		       rsu_upnp_task_complete_t cb,
@@ -60,6 +65,10 @@ void rsu_upnp_get_all_props(rsu_upnp_t *upnp, rsu_task_t *task,
 			    GCancellable *cancellable,
 			    rsu_upnp_task_complete_t cb,
 			    void *user_data);
+void rsu_upnp_set_prop(rsu_upnp_t *upnp, rsu_task_t *task,
+		       GCancellable *cancellable,
+		       rsu_upnp_task_complete_t cb,
+		       void *user_data);
 void rsu_upnp_play(rsu_upnp_t *upnp, rsu_task_t *task,
 		   GCancellable *cancellable,
 		   rsu_upnp_task_complete_t cb,
@@ -104,6 +113,14 @@ void rsu_upnp_remove_uri(rsu_upnp_t *upnp, rsu_task_t *task,
 			 GCancellable *cancellable,
 			 rsu_upnp_task_complete_t cb,
 			 void *user_data);
+void rsu_upnp_update_uri(rsu_upnp_t *upnp, rsu_task_t *task,
+			 GCancellable *cancellable,
+			 rsu_upnp_task_complete_t cb,
+			 void *user_data);
+void rsu_upnp_host_fd(rsu_upnp_t *upnp, rsu_task_t *task,
+		      GCancellable *cancellable,
+		      rsu_upnp_task_complete_t cb,
+		      void *user_data);
 void rsu_upnp_lost_client(rsu_upnp_t *upnp, const gchar *client_name);
 
 #endif
@@ -45,11 +45,10 @@ class Renderer:
 
     def push_file(self, fname):
         try:
-            self.__hostIF.RemoveFile(fname)
+            uri = self.__hostIF.UpdateFile(fname)
         except:
-            pass
+            uri = self.__hostIF.HostFile(fname)
         self.__playerIF.Stop()
-        uri = self.__hostIF.HostFile(fname)
         self.__playerIF.OpenUri(uri)
         self.__playerIF.Play()
 
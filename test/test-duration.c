@@ -0,0 +1,146 @@
+/*
+ * renderer-service-upnp
+ *
+ * Copyright (C) 2012 Intel Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St - Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Mark Ryan <mark.d.ryan@intel.com>
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "duration.h"
+
+/* Parses per iteration of the benchmark */
+#define TEST_DURATION_BENCH_COUNT 1000000
+
+typedef struct test_duration_t_ test_duration_t;
+struct test_duration_t_ {
+	const gchar *duration;
+	gint64 micro_seconds;
+};
+
+/* Strings sent by renderers in the wild, and some they should not
+   send */
+
+static const test_duration_t g_parse_cases[] = {
+	{ "0:00:00", 0 },
+	{ "00:03:25", G_GINT64_CONSTANT(205000000) },
+	{ "0:5:7", G_GINT64_CONSTANT(307000000) },
+	{ "1:02:03.5", G_GINT64_CONSTANT(3723500000) },
+	{ "01:02:03.000", G_GINT64_CONSTANT(3723000000) },
+	{ "01:02:03.123456789", G_GINT64_CONSTANT(3723123456) },
+	{ "0:00:01.1/4", G_GINT64_CONSTANT(1250000) },
+	{ "0:00:01.1/3", G_GINT64_CONSTANT(1333333) },
+	{ "100:00:00", G_GINT64_CONSTANT(360000000000) },
+	{ "2562047788:00:00", G_GINT64_CONSTANT(9223372036800000000) },
+	{ "-0:00:05", G_GINT64_CONSTANT(-5000000) },
+	{ "+0:00:05", G_GINT64_CONSTANT(5000000) },
+	{ " 0:00:05 ", G_GINT64_CONSTANT(5000000) },
+	{ "NOT_IMPLEMENTED", 0 },
+	{ "", 0 },
+	{ "1:00", 0 },
+	{ "0:60:00", 0 },
+	{ "0:00:60", 0 },
+	{ "0:000:00", 0 },
+	{ "0:00:05.", 0 },
+	{ "0:00:01.3/3", 0 },
+	{ "0:00:01.1/0", 0 },
+	{ "0:00:05abc", 0 },
+	{ "2562047789:00:00", 0 },
+	{ NULL, 0 }
+};
+
+static const test_duration_t g_format_cases[] = {
+	{ "00:00:00", 0 },
+	{ "00:03:25", G_GINT64_CONSTANT(205000000) },
+	{ "01:02:03.5", G_GINT64_CONSTANT(3723500000) },
+	{ "00:00:01.25", G_GINT64_CONSTANT(1250000) },
+	{ "00:00:00.000001", 1 },
+	{ "100:00:00", G_GINT64_CONSTANT(360000000000) },
+	{ "-00:00:05", G_GINT64_CONSTANT(-5000000) },
+	{ NULL, 0 }
+};
+
+static void prv_test_parse(void)
+{
+	const test_duration_t *test;
+
+	for (test = g_parse_cases; test->duration; ++test)
+		g_assert_cmpint(rsu_duration_to_int64(test->duration), ==,
+				test->micro_seconds);
+}
+
+static void prv_test_format(void)
+{
+	const test_duration_t *test;
+	gchar buffer[RSU_DURATION_BUFFER_SIZE];
+
+	for (test = g_format_cases; test->duration; ++test) {
+		rsu_duration_from_int64(test->micro_seconds, buffer);
+		g_assert_cmpstr(buffer, ==, test->duration);
+		g_assert_cmpint(rsu_duration_to_int64(buffer), ==,
+				test->micro_seconds);
+	}
+}
+
+static void prv_test_format_largest(void)
+{
+	gchar buffer[RSU_DURATION_BUFFER_SIZE];
+
+	rsu_duration_from_int64(G_MININT64, buffer);
+	g_assert_cmpuint(strlen(buffer), <, sizeof(buffer));
+}
+
+static void prv_bench_parse(void)
+{
+	const test_duration_t *test;
+	guint count = 0;
+	gdouble elapsed;
+
+	/* Only run with -m perf */
+
+	if (!g_test_perf())
+		return;
+
+	g_test_timer_start();
+
+	while (count < TEST_DURATION_BENCH_COUNT)
+		for (test = g_parse_cases; test->duration; ++test) {
+			(void) rsu_duration_to_int64(test->duration);
+			++count;
+		}
+
+	elapsed = g_test_timer_elapsed();
+
+	g_test_maximized_result(count / elapsed,
+				"%g durations parsed per second",
+				count / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/duration/parse", prv_test_parse);
+	g_test_add_func("/duration/format", prv_test_format);
+	g_test_add_func("/duration/format-largest", prv_test_format_largest);
+	g_test_add_func("/duration/bench-parse", prv_bench_parse);
+
+	return g_test_run();
+}